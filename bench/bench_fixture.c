@@ -0,0 +1,426 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+#include "bench_fixture.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNITS_PER_EM 1000
+#define ATLAS_WIDTH 4096
+#define ATLAS_CELL 32
+#define MAX_KERNING_PAIRS 10000 /* the kern subtable length is 16 bits */
+#define KERNING_COLUMNS 64
+
+typedef struct Buffer
+{
+	uint8_t *data;
+	uint32_t length;
+	uint32_t capacity;
+} Buffer;
+
+static void Buffer_Reserve(Buffer *buffer, uint32_t length)
+{
+	if (buffer->length + length > buffer->capacity)
+	{
+		while (buffer->length + length > buffer->capacity)
+		{
+			buffer->capacity = buffer->capacity == 0 ? 4096 : buffer->capacity * 2;
+		}
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+}
+
+static void Buffer_U16(Buffer *buffer, uint16_t value)
+{
+	Buffer_Reserve(buffer, 2);
+	buffer->data[buffer->length + 0] = (uint8_t) (value >> 8);
+	buffer->data[buffer->length + 1] = (uint8_t) value;
+	buffer->length += 2;
+}
+
+static void Buffer_U32(Buffer *buffer, uint32_t value)
+{
+	Buffer_U16(buffer, (uint16_t) (value >> 16));
+	Buffer_U16(buffer, (uint16_t) value);
+}
+
+static void Buffer_Zero(Buffer *buffer, uint32_t length)
+{
+	Buffer_Reserve(buffer, length);
+	memset(buffer->data + buffer->length, 0, length);
+	buffer->length += length;
+}
+
+static void Buffer_Printf(Buffer *buffer, const char *format, ...)
+{
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	Buffer_Reserve(buffer, (uint32_t) length + 1);
+
+	va_start(args, format);
+	vsnprintf((char*) buffer->data + buffer->length, (size_t) length + 1, format, args);
+	va_end(args);
+
+	buffer->length += (uint32_t) length;
+}
+
+/* Glyph metrics are derived from the glyph index, so the TTF and JSON agree */
+
+static uint16_t GlyphAdvance(uint32_t glyph)
+{
+	return (uint16_t) (450 + (glyph * 37) % 300);
+}
+
+static uint32_t KerningPairCount(uint32_t codepointCount, uint32_t kerningPairCount)
+{
+	uint32_t columns = codepointCount < KERNING_COLUMNS ? codepointCount : KERNING_COLUMNS;
+	uint32_t maxPairs = columns * codepointCount;
+
+	if (kerningPairCount > maxPairs)
+	{
+		kerningPairCount = maxPairs;
+	}
+
+	return kerningPairCount < MAX_KERNING_PAIRS ? kerningPairCount : MAX_KERNING_PAIRS;
+}
+
+/* Pairs are generated in (left, right) order, which is the order the kern table needs */
+static void KerningPair(uint32_t codepointCount, uint32_t pair, uint32_t *pLeft, uint32_t *pRight, int16_t *pValue)
+{
+	uint32_t columns = codepointCount < KERNING_COLUMNS ? codepointCount : KERNING_COLUMNS;
+
+	*pLeft = 1 + pair / columns;
+	*pRight = 1 + pair % columns;
+	*pValue = (int16_t) -(int16_t) ((pair * 13) % 60);
+}
+
+/* TTF */
+
+typedef struct Table
+{
+	const char *tag;
+	Buffer data;
+} Table;
+
+static void WriteCmap(Buffer *buffer, const uint32_t *codepoints, uint32_t codepointCount)
+{
+	uint32_t groupCount = 0;
+	uint32_t i, start;
+
+	for (i = 0; i < codepointCount; i += 1)
+	{
+		if (i == 0 || codepoints[i] != codepoints[i - 1] + 1)
+		{
+			groupCount += 1;
+		}
+	}
+
+	/* One Microsoft UCS-4 subtable in format 12 */
+	Buffer_U16(buffer, 0);
+	Buffer_U16(buffer, 1);
+	Buffer_U16(buffer, 3);
+	Buffer_U16(buffer, 10);
+	Buffer_U32(buffer, 12);
+
+	Buffer_U16(buffer, 12);
+	Buffer_U16(buffer, 0);
+	Buffer_U32(buffer, 16 + groupCount * 12);
+	Buffer_U32(buffer, 0);
+	Buffer_U32(buffer, groupCount);
+
+	start = 0;
+	for (i = 1; i <= codepointCount; i += 1)
+	{
+		if (i == codepointCount || codepoints[i] != codepoints[i - 1] + 1)
+		{
+			Buffer_U32(buffer, codepoints[start]);
+			Buffer_U32(buffer, codepoints[i - 1]);
+			Buffer_U32(buffer, start + 1);
+			start = i;
+		}
+	}
+}
+
+static void WriteHead(Buffer *buffer)
+{
+	Buffer_U32(buffer, 0x00010000); /* version */
+	Buffer_U32(buffer, 0x00010000); /* fontRevision */
+	Buffer_U32(buffer, 0); /* checkSumAdjustment */
+	Buffer_U32(buffer, 0x5F0F3CF5); /* magicNumber */
+	Buffer_U16(buffer, 0); /* flags */
+	Buffer_U16(buffer, UNITS_PER_EM);
+	Buffer_Zero(buffer, 16); /* created, modified */
+	Buffer_U16(buffer, 0); /* xMin */
+	Buffer_U16(buffer, (uint16_t) -200); /* yMin */
+	Buffer_U16(buffer, UNITS_PER_EM); /* xMax */
+	Buffer_U16(buffer, 800); /* yMax */
+	Buffer_U16(buffer, 0); /* macStyle */
+	Buffer_U16(buffer, 8); /* lowestRecPPEM */
+	Buffer_U16(buffer, 2); /* fontDirectionHint */
+	Buffer_U16(buffer, 0); /* indexToLocFormat: short offsets */
+	Buffer_U16(buffer, 0); /* glyphDataFormat */
+}
+
+static void WriteHhea(Buffer *buffer, uint32_t glyphCount)
+{
+	Buffer_U32(buffer, 0x00010000); /* version */
+	Buffer_U16(buffer, 800); /* ascender */
+	Buffer_U16(buffer, (uint16_t) -200); /* descender */
+	Buffer_U16(buffer, 0); /* lineGap */
+	Buffer_U16(buffer, 750); /* advanceWidthMax */
+	Buffer_Zero(buffer, 22); /* bounds, caret and reserved fields */
+	Buffer_U16(buffer, 0); /* metricDataFormat */
+	Buffer_U16(buffer, (uint16_t) glyphCount); /* numberOfHMetrics */
+}
+
+static void WriteHmtx(Buffer *buffer, uint32_t glyphCount)
+{
+	uint32_t i;
+
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		Buffer_U16(buffer, GlyphAdvance(i));
+		Buffer_U16(buffer, 0);
+	}
+}
+
+static void WriteKern(Buffer *buffer, uint32_t codepointCount, uint32_t pairCount)
+{
+	uint32_t searchRange = 1, entrySelector = 0;
+	uint32_t left, right, i;
+	int16_t value;
+
+	while (searchRange * 2 <= pairCount)
+	{
+		searchRange *= 2;
+		entrySelector += 1;
+	}
+
+	Buffer_U16(buffer, 0); /* version */
+	Buffer_U16(buffer, 1); /* nTables */
+	Buffer_U16(buffer, 0); /* subtable version */
+	Buffer_U16(buffer, (uint16_t) (14 + pairCount * 6)); /* length */
+	Buffer_U16(buffer, 1); /* coverage: horizontal, format 0 */
+	Buffer_U16(buffer, (uint16_t) pairCount);
+	Buffer_U16(buffer, (uint16_t) (searchRange * 6));
+	Buffer_U16(buffer, (uint16_t) entrySelector);
+	Buffer_U16(buffer, (uint16_t) ((pairCount - searchRange) * 6));
+
+	for (i = 0; i < pairCount; i += 1)
+	{
+		KerningPair(codepointCount, i, &left, &right, &value);
+		Buffer_U16(buffer, (uint16_t) left);
+		Buffer_U16(buffer, (uint16_t) right);
+		Buffer_U16(buffer, (uint16_t) value);
+	}
+}
+
+static void WriteFont(
+	Buffer *buffer,
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	uint32_t kerningPairCount
+) {
+	Table tables[8];
+	uint32_t tableCount = 0;
+	uint32_t glyphCount = codepointCount + 1; /* glyph 0 is .notdef */
+	uint32_t offset, i;
+
+	memset(tables, 0, sizeof(tables));
+
+	/* Tags in ascending order */
+	tables[tableCount].tag = "cmap";
+	WriteCmap(&tables[tableCount].data, codepoints, codepointCount);
+	tableCount += 1;
+
+	tables[tableCount].tag = "glyf";
+	tableCount += 1;
+
+	tables[tableCount].tag = "head";
+	WriteHead(&tables[tableCount].data);
+	tableCount += 1;
+
+	tables[tableCount].tag = "hhea";
+	WriteHhea(&tables[tableCount].data, glyphCount);
+	tableCount += 1;
+
+	tables[tableCount].tag = "hmtx";
+	WriteHmtx(&tables[tableCount].data, glyphCount);
+	tableCount += 1;
+
+	if (kerningPairCount > 0)
+	{
+		tables[tableCount].tag = "kern";
+		WriteKern(&tables[tableCount].data, codepointCount, kerningPairCount);
+		tableCount += 1;
+	}
+
+	/* Every glyph is empty, so every offset is zero */
+	tables[tableCount].tag = "loca";
+	Buffer_Zero(&tables[tableCount].data, (glyphCount + 1) * 2);
+	tableCount += 1;
+
+	tables[tableCount].tag = "maxp";
+	Buffer_U32(&tables[tableCount].data, 0x00005000);
+	Buffer_U16(&tables[tableCount].data, (uint16_t) glyphCount);
+	tableCount += 1;
+
+	Buffer_U32(buffer, 0x00010000);
+	Buffer_U16(buffer, (uint16_t) tableCount);
+	Buffer_Zero(buffer, 6); /* searchRange, entrySelector, rangeShift */
+
+	offset = 12 + tableCount * 16;
+	for (i = 0; i < tableCount; i += 1)
+	{
+		Buffer_Reserve(buffer, 4);
+		memcpy(buffer->data + buffer->length, tables[i].tag, 4);
+		buffer->length += 4;
+		Buffer_U32(buffer, 0); /* checksum, not verified by stb_truetype */
+		Buffer_U32(buffer, offset);
+		Buffer_U32(buffer, tables[i].data.length);
+		offset += (tables[i].data.length + 3) & ~3u;
+	}
+
+	for (i = 0; i < tableCount; i += 1)
+	{
+		if (tables[i].data.length > 0)
+		{
+			Buffer_Reserve(buffer, tables[i].data.length);
+			memcpy(buffer->data + buffer->length, tables[i].data.data, tables[i].data.length);
+			buffer->length += tables[i].data.length;
+		}
+		Buffer_Zero(buffer, ((tables[i].data.length + 3) & ~3u) - tables[i].data.length);
+		free(tables[i].data.data);
+	}
+}
+
+/* Atlas JSON */
+
+static void WriteAtlasJson(
+	Buffer *buffer,
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	uint32_t kerningPairCount,
+	uint8_t atlasKerning
+) {
+	uint32_t columns = ATLAS_WIDTH / ATLAS_CELL;
+	uint32_t rows = (codepointCount + columns - 1) / columns;
+	uint32_t left, right, i;
+	int16_t value;
+	double advance;
+
+	Buffer_Printf(
+		buffer,
+		"{\"atlas\":{\"type\":\"msdf\",\"distanceRange\":4,\"size\":32,\"width\":%u,\"height\":%u,\"yOrigin\":\"top\"},"
+		"\"metrics\":{\"emSize\":1,\"lineHeight\":1.2,\"ascender\":-0.8,\"descender\":0.2,\"underlineY\":0.1,\"underlineThickness\":0.05},"
+		"\"glyphs\":[",
+		ATLAS_WIDTH,
+		rows * ATLAS_CELL
+	);
+
+	for (i = 0; i < codepointCount; i += 1)
+	{
+		advance = (double) GlyphAdvance(i + 1) / UNITS_PER_EM;
+
+		Buffer_Printf(buffer, "%s{\"unicode\":%u,\"advance\":%g", i == 0 ? "" : ",", codepoints[i], advance);
+
+		if (codepoints[i] != ' ')
+		{
+			Buffer_Printf(
+				buffer,
+				",\"planeBounds\":{\"left\":0.05,\"bottom\":0.2,\"right\":%g,\"top\":-0.75}"
+				",\"atlasBounds\":{\"left\":%u.5,\"bottom\":%u.5,\"right\":%u.5,\"top\":%u.5}",
+				advance - 0.05,
+				(i % columns) * ATLAS_CELL,
+				(i / columns) * ATLAS_CELL + ATLAS_CELL - 1,
+				(i % columns) * ATLAS_CELL + ATLAS_CELL - 1,
+				(i / columns) * ATLAS_CELL
+			);
+		}
+
+		Buffer_Printf(buffer, "}");
+	}
+
+	Buffer_Printf(buffer, "]");
+
+	if (atlasKerning)
+	{
+		Buffer_Printf(buffer, ",\"kerning\":[");
+
+		for (i = 0; i < kerningPairCount; i += 1)
+		{
+			KerningPair(codepointCount, i, &left, &right, &value);
+			Buffer_Printf(
+				buffer,
+				"%s{\"unicode1\":%u,\"unicode2\":%u,\"advance\":%g}",
+				i == 0 ? "" : ",",
+				codepoints[left - 1],
+				codepoints[right - 1],
+				(double) value / UNITS_PER_EM
+			);
+		}
+
+		Buffer_Printf(buffer, "]");
+	}
+
+	Buffer_Printf(buffer, "}");
+}
+
+void BenchFixture_Create(
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	uint32_t kerningPairCount,
+	uint8_t atlasKerning,
+	BenchFixture *fixture
+) {
+	Buffer font = { 0 };
+	Buffer json = { 0 };
+
+	kerningPairCount = KerningPairCount(codepointCount, kerningPairCount);
+
+	WriteFont(&font, codepoints, codepointCount, kerningPairCount);
+	WriteAtlasJson(&json, codepoints, codepointCount, kerningPairCount, atlasKerning);
+
+	fixture->fontBytes = font.data;
+	fixture->fontBytesLength = font.length;
+	fixture->atlasJsonBytes = json.data;
+	fixture->atlasJsonBytesLength = json.length;
+}
+
+void BenchFixture_Destroy(BenchFixture *fixture)
+{
+	free(fixture->fontBytes);
+	free(fixture->atlasJsonBytes);
+	memset(fixture, 0, sizeof(BenchFixture));
+}
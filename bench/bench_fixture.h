@@ -0,0 +1,60 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+#ifndef BENCH_FIXTURE_H
+#define BENCH_FIXTURE_H
+
+#include <stdint.h>
+
+/* A synthetic font and its msdf-atlas-gen style JSON, generated in memory so
+ * the benchmarks don't depend on any files.
+ * The TTF only has the tables Wellspring reads: glyph indices, horizontal
+ * metrics and an optional kern table. Outlines are empty.
+ * Codepoint i of the input maps to glyph i + 1.
+ */
+typedef struct BenchFixture
+{
+	uint8_t *fontBytes;
+	uint32_t fontBytesLength;
+	uint8_t *atlasJsonBytes;
+	uint32_t atlasJsonBytesLength;
+} BenchFixture;
+
+/* codepoints must be sorted and unique.
+ * kerningPairCount pairs are written to the kern table, and to the JSON too
+ * when atlasKerning is set. Without it the JSON has no kerning key at all.
+ */
+void BenchFixture_Create(
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	uint32_t kerningPairCount,
+	uint8_t atlasKerning,
+	BenchFixture *fixture
+);
+
+void BenchFixture_Destroy(BenchFixture *fixture);
+
+#endif /* BENCH_FIXTURE_H */
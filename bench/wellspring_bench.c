@@ -0,0 +1,442 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Layout throughput benchmark.
+ *
+ * Usage: wellspring_bench [--min-time-ms N] [--filter SUBSTRING]
+ *
+ * Prints one CSV row per case, so results can be diffed across commits.
+ */
+
+#include "Wellspring.h"
+#include "bench_fixture.h"
+
+#include <SDL3/SDL_timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODEPOINTS 1024
+#define LARGE_CJK_FIRST 0x4E00
+#define LARGE_CJK_COUNT 20992 /* the whole CJK Unified Ideographs block */
+#define MAX_STRINGS 4096
+#define PIXEL_SIZE 16
+#define KERNING_PAIRS 2000
+
+typedef struct BenchString
+{
+	uint8_t *bytes;
+	uint32_t length;
+} BenchString;
+
+typedef struct BenchCase
+{
+	const char *name;
+	BenchString *strings;
+	uint32_t stringCount;
+	Wellspring_HorizontalAlignment horizontalAlignment;
+	Wellspring_VerticalAlignment verticalAlignment;
+	uint8_t bounds; /* measure Wellspring_TextBounds instead of batching */
+	Wellspring_Font *font; /* NULL for the default font */
+} BenchCase;
+
+static const char *labels[] = {
+	"Health", "Mana", "Stamina", "Gold: 12,345", "Level 42", "Experience 8812/12000",
+	"Options", "Video", "Audio", "Controls", "Resume", "Quit to Desktop",
+	"Inventory", "Equipment", "Quest Log", "Map", "FPS: 144", "Ping: 23ms",
+	"Press [E] to interact", "Achievement unlocked!", "Sword of Dawn +3", "Damage 17-24",
+	"Armor 120", "Weight 4.5/60.0", "Player 1", "Player 2", "Team Blue", "Team Red",
+	"Round 3 of 5", "00:42.17", "Checkpoint reached", "Saving..."
+};
+
+static const char *paragraph =
+	"It was a bright cold day in April, and the clocks were striking thirteen.\n"
+	"The hallway smelt of boiled cabbage and old rag mats. At one end of it a\n"
+	"coloured poster, too large for indoor display, had been tacked to the wall.\n"
+	"It depicted simply an enormous face, more than a metre wide: the face of a\n"
+	"man of about forty-five, with a heavy black moustache and ruggedly handsome\n"
+	"features. The flat was seven flights up, and he was thirty-nine and had a\n"
+	"varicose ulcer above his right ankle, went slowly, resting several times on\n"
+	"the way. On each landing, opposite the lift-shaft, the poster with the\n"
+	"enormous face gazed from the wall. It was one of those pictures which are so\n"
+	"contrived that the eyes follow you about when you move.\n";
+
+static uint32_t EncodeUTF8(uint32_t codepoint, uint8_t *bytes)
+{
+	if (codepoint < 0x80)
+	{
+		bytes[0] = (uint8_t) codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800)
+	{
+		bytes[0] = (uint8_t) (0xC0 | (codepoint >> 6));
+		bytes[1] = (uint8_t) (0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	bytes[0] = (uint8_t) (0xE0 | (codepoint >> 12));
+	bytes[1] = (uint8_t) (0x80 | ((codepoint >> 6) & 0x3F));
+	bytes[2] = (uint8_t) (0x80 | (codepoint & 0x3F));
+	return 3;
+}
+
+static BenchString MakeString(const char *str)
+{
+	BenchString result;
+	result.length = (uint32_t) strlen(str);
+	result.bytes = malloc(result.length);
+	memcpy(result.bytes, str, result.length);
+	return result;
+}
+
+/* Deterministic CJK text: runs of ideographs separated by full-width punctuation */
+static BenchString MakeCJKString(uint32_t characterCount, uint32_t ideographCount)
+{
+	BenchString result;
+	uint32_t i, seed = 1;
+
+	result.bytes = malloc(characterCount * 3);
+	result.length = 0;
+
+	for (i = 0; i < characterCount; i += 1)
+	{
+		seed = seed * 1103515245 + 12345;
+		result.length += EncodeUTF8(
+			i % 24 == 23 ? 0x3002 : 0x4E00 + (seed >> 16) % ideographCount,
+			result.bytes + result.length
+		);
+	}
+
+	return result;
+}
+
+static uint32_t CountGlyphs(Wellspring_Font *font, Wellspring_TextBatch *batch, BenchCase *benchCase)
+{
+	uint32_t vertexCount, i;
+	Wellspring_Vertex *vertices;
+
+	Wellspring_StartTextBatch(batch);
+	for (i = 0; i < benchCase->stringCount; i += 1)
+	{
+		Wellspring_AddChunkToTextBatch(
+			batch,
+			font,
+			PIXEL_SIZE,
+			benchCase->horizontalAlignment,
+			benchCase->verticalAlignment,
+			benchCase->strings[i].bytes,
+			benchCase->strings[i].length
+		);
+	}
+	Wellspring_GetBufferData(batch, &vertexCount, &vertices);
+
+	return vertexCount / 4;
+}
+
+static void RunIteration(Wellspring_Font *font, Wellspring_TextBatch *batch, BenchCase *benchCase)
+{
+	Wellspring_Rectangle rectangle;
+	uint32_t i;
+
+	if (benchCase->bounds)
+	{
+		for (i = 0; i < benchCase->stringCount; i += 1)
+		{
+			Wellspring_TextBounds(
+				font,
+				PIXEL_SIZE,
+				benchCase->horizontalAlignment,
+				benchCase->verticalAlignment,
+				benchCase->strings[i].bytes,
+				benchCase->strings[i].length,
+				&rectangle
+			);
+		}
+		return;
+	}
+
+	Wellspring_StartTextBatch(batch);
+	for (i = 0; i < benchCase->stringCount; i += 1)
+	{
+		Wellspring_AddChunkToTextBatch(
+			batch,
+			font,
+			PIXEL_SIZE,
+			benchCase->horizontalAlignment,
+			benchCase->verticalAlignment,
+			benchCase->strings[i].bytes,
+			benchCase->strings[i].length
+		);
+	}
+}
+
+static void RunCase(Wellspring_Font *font, Wellspring_TextBatch *batch, BenchCase *benchCase, uint64_t minTimeNS)
+{
+	uint32_t glyphCount = CountGlyphs(font, batch, benchCase);
+	uint64_t iterations = 0;
+	uint64_t start, elapsed;
+	double nsPerGlyph;
+
+	/* Warm up caches and let the batch reach its steady-state capacity */
+	RunIteration(font, batch, benchCase);
+
+	start = SDL_GetTicksNS();
+	do
+	{
+		RunIteration(font, batch, benchCase);
+		iterations += 1;
+		elapsed = SDL_GetTicksNS() - start;
+	} while (elapsed < minTimeNS);
+
+	nsPerGlyph = (double) elapsed / ((double) iterations * (glyphCount > 0 ? glyphCount : 1));
+
+	printf(
+		"%s,%u,%u,%llu,%.3f,%.0f\n",
+		benchCase->name,
+		benchCase->stringCount,
+		glyphCount,
+		(unsigned long long) iterations,
+		nsPerGlyph,
+		1e9 / nsPerGlyph
+	);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	static const char *horizontalNames[] = { "left", "center", "right" };
+	static const char *verticalNames[] = { "baseline", "top", "middle", "bottom" };
+
+	uint32_t codepoints[MAX_CODEPOINTS];
+	uint32_t codepointCount = 0;
+	uint32_t *largeCodepoints;
+	BenchFixture fixture, largeFixture;
+	Wellspring_Font *font, *largeFont;
+	Wellspring_TextBatch *batch;
+	float pixelsPerEm, distanceRange;
+
+	BenchString labelStrings[sizeof(labels) / sizeof(labels[0])];
+	BenchString paragraphStrings[4];
+	BenchString cjkStrings[1];
+	BenchString largeCJKStrings[1];
+	BenchString tinyStrings[MAX_STRINGS];
+	uint32_t labelCount = sizeof(labels) / sizeof(labels[0]);
+
+	BenchCase cases[32];
+	char alignmentNames[12][32];
+	uint32_t caseCount = 0;
+	const char *filter = NULL;
+	uint64_t minTimeNS = 250000000;
+	uint32_t codepoint, i, h, v;
+	char tiny[3];
+
+	for (i = 1; i < (uint32_t) argc; i += 1)
+	{
+		if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < (uint32_t) argc)
+		{
+			minTimeNS = strtoull(argv[++i], NULL, 10) * 1000000;
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < (uint32_t) argc)
+		{
+			filter = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--min-time-ms N] [--filter SUBSTRING]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Printable ASCII, Latin-1, CJK punctuation and 512 ideographs */
+	for (codepoint = 0x20; codepoint < 0x7F; codepoint += 1)
+	{
+		codepoints[codepointCount++] = codepoint;
+	}
+	for (codepoint = 0xA0; codepoint < 0x100; codepoint += 1)
+	{
+		codepoints[codepointCount++] = codepoint;
+	}
+	for (codepoint = 0x3000; codepoint < 0x3020; codepoint += 1)
+	{
+		codepoints[codepointCount++] = codepoint;
+	}
+	for (codepoint = 0x4E00; codepoint < 0x5000; codepoint += 1)
+	{
+		codepoints[codepointCount++] = codepoint;
+	}
+
+	BenchFixture_Create(codepoints, codepointCount, KERNING_PAIRS, 0, &fixture);
+
+	font = Wellspring_CreateFont(
+		fixture.fontBytes,
+		fixture.fontBytesLength,
+		fixture.atlasJsonBytes,
+		fixture.atlasJsonBytesLength,
+		&pixelsPerEm,
+		&distanceRange
+	);
+
+	/* Big enough that the glyph table doesn't fit in cache */
+	largeCodepoints = malloc(sizeof(uint32_t) * (LARGE_CJK_COUNT + 1));
+	largeCodepoints[0] = 0x3002;
+	for (i = 0; i < LARGE_CJK_COUNT; i += 1)
+	{
+		largeCodepoints[i + 1] = LARGE_CJK_FIRST + i;
+	}
+
+	BenchFixture_Create(largeCodepoints, LARGE_CJK_COUNT + 1, KERNING_PAIRS, 0, &largeFixture);
+	free(largeCodepoints);
+
+	largeFont = Wellspring_CreateFont(
+		largeFixture.fontBytes,
+		largeFixture.fontBytesLength,
+		largeFixture.atlasJsonBytes,
+		largeFixture.atlasJsonBytesLength,
+		&pixelsPerEm,
+		&distanceRange
+	);
+
+	if (font == NULL || largeFont == NULL)
+	{
+		fprintf(stderr, "Failed to create the fixture font!\n");
+		return 1;
+	}
+
+	batch = Wellspring_CreateTextBatch();
+
+	for (i = 0; i < labelCount; i += 1)
+	{
+		labelStrings[i] = MakeString(labels[i]);
+	}
+	for (i = 0; i < 4; i += 1)
+	{
+		paragraphStrings[i] = MakeString(paragraph);
+	}
+	cjkStrings[0] = MakeCJKString(2048, 512);
+	largeCJKStrings[0] = MakeCJKString(16384, LARGE_CJK_COUNT);
+	for (i = 0; i < MAX_STRINGS; i += 1)
+	{
+		tiny[0] = (char) ('0' + i % 10);
+		tiny[1] = (char) ('A' + i % 26);
+		tiny[1 + i % 2] = '\0';
+		tinyStrings[i] = MakeString(tiny);
+	}
+
+	memset(cases, 0, sizeof(cases));
+
+	cases[caseCount].name = "ascii_labels";
+	cases[caseCount].strings = labelStrings;
+	cases[caseCount].stringCount = labelCount;
+	caseCount += 1;
+
+	cases[caseCount].name = "paragraph";
+	cases[caseCount].strings = paragraphStrings;
+	cases[caseCount].stringCount = 4;
+	caseCount += 1;
+
+	cases[caseCount].name = "cjk";
+	cases[caseCount].strings = cjkStrings;
+	cases[caseCount].stringCount = 1;
+	caseCount += 1;
+
+	cases[caseCount].name = "cjk_large_font";
+	cases[caseCount].strings = largeCJKStrings;
+	cases[caseCount].stringCount = 1;
+	cases[caseCount].font = largeFont;
+	caseCount += 1;
+
+	cases[caseCount].name = "tiny_chunks";
+	cases[caseCount].strings = tinyStrings;
+	cases[caseCount].stringCount = MAX_STRINGS;
+	caseCount += 1;
+
+	for (h = 0; h < 3; h += 1)
+	{
+		for (v = 0; v < 4; v += 1)
+		{
+			snprintf(alignmentNames[h * 4 + v], sizeof(alignmentNames[0]), "align_%s_%s", horizontalNames[h], verticalNames[v]);
+			cases[caseCount].name = alignmentNames[h * 4 + v];
+			cases[caseCount].strings = labelStrings;
+			cases[caseCount].stringCount = labelCount;
+			cases[caseCount].horizontalAlignment = (Wellspring_HorizontalAlignment) h;
+			cases[caseCount].verticalAlignment = (Wellspring_VerticalAlignment) v;
+			caseCount += 1;
+		}
+	}
+
+	cases[caseCount].name = "bounds_ascii_labels";
+	cases[caseCount].strings = labelStrings;
+	cases[caseCount].stringCount = labelCount;
+	cases[caseCount].bounds = 1;
+	caseCount += 1;
+
+	cases[caseCount].name = "bounds_paragraph";
+	cases[caseCount].strings = paragraphStrings;
+	cases[caseCount].stringCount = 4;
+	cases[caseCount].bounds = 1;
+	caseCount += 1;
+
+	cases[caseCount].name = "bounds_cjk_large_font";
+	cases[caseCount].strings = largeCJKStrings;
+	cases[caseCount].stringCount = 1;
+	cases[caseCount].bounds = 1;
+	cases[caseCount].font = largeFont;
+	caseCount += 1;
+
+	printf("case,chunks,glyphs,iterations,ns_per_glyph,glyphs_per_second\n");
+
+	for (i = 0; i < caseCount; i += 1)
+	{
+		if (filter == NULL || strstr(cases[i].name, filter) != NULL)
+		{
+			RunCase(cases[i].font != NULL ? cases[i].font : font, batch, &cases[i], minTimeNS);
+		}
+	}
+
+	for (i = 0; i < labelCount; i += 1)
+	{
+		free(labelStrings[i].bytes);
+	}
+	for (i = 0; i < 4; i += 1)
+	{
+		free(paragraphStrings[i].bytes);
+	}
+	free(cjkStrings[0].bytes);
+	free(largeCJKStrings[0].bytes);
+	for (i = 0; i < MAX_STRINGS; i += 1)
+	{
+		free(tinyStrings[i].bytes);
+	}
+
+	Wellspring_DestroyTextBatch(batch);
+	Wellspring_DestroyFont(font);
+	Wellspring_DestroyFont(largeFont);
+	BenchFixture_Destroy(&fixture);
+	BenchFixture_Destroy(&largeFixture);
+
+	return 0;
+}
@@ -0,0 +1,381 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Font load benchmark.
+ *
+ * Usage: wellspring_bench_font [--min-time-ms N] [--max-glyphs N]
+ *
+ * Times Wellspring_CreateFont on generated atlases of 100 to 50k glyphs, with
+ * dense or fragmented codepoints, without kerning or with kerning from the
+ * font file or the atlas JSON, and with or without font arenas. Reports the
+ * peak heap usage and allocation count seen through Wellspring's allocator.
+ * Prints one CSV row per case.
+ *
+ * The JSON parse, stb_truetype init, glyph ingest and kerning phases are timed
+ * with the profiler zones Wellspring_CreateFont reports. Atlas kerning cases
+ * pass no font file, so they have no stb_truetype init.
+ */
+
+#include "Wellspring.h"
+#include "bench_fixture.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KERNING_PAIRS 10000
+#define MIN_REPETITIONS 3
+
+/* Counting allocator */
+
+/* Keeps malloc's alignment for the caller */
+#define HEADER_SIZE 16
+
+static size_t currentBytes;
+static size_t peakBytes;
+static size_t currentBlocks;
+
+static void TrackAllocation(size_t size)
+{
+	currentBytes += size;
+	if (currentBytes > peakBytes)
+	{
+		peakBytes = currentBytes;
+	}
+}
+
+static void* WELLSPRINGCALL CountingMalloc(void *userdata, size_t size)
+{
+	uint8_t *block = malloc(size + HEADER_SIZE);
+
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	*(size_t*) block = size;
+	TrackAllocation(size);
+	currentBlocks += 1;
+	return block + HEADER_SIZE;
+}
+
+static void WELLSPRINGCALL CountingFree(void *userdata, void *mem)
+{
+	uint8_t *block;
+
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	block = (uint8_t*) mem - HEADER_SIZE;
+	currentBytes -= *(size_t*) block;
+	currentBlocks -= 1;
+	free(block);
+}
+
+static void* WELLSPRINGCALL CountingRealloc(void *userdata, void *mem, size_t size)
+{
+	uint8_t *block;
+	size_t oldSize;
+
+	if (mem == NULL)
+	{
+		return CountingMalloc(userdata, size);
+	}
+
+	block = (uint8_t*) mem - HEADER_SIZE;
+	oldSize = *(size_t*) block;
+
+	block = realloc(block, size + HEADER_SIZE);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	*(size_t*) block = size;
+	currentBytes -= oldSize;
+	TrackAllocation(size);
+	return block + HEADER_SIZE;
+}
+
+/* Phase timing */
+
+typedef enum Phase
+{
+	PHASE_PARSE,
+	PHASE_INIT,
+	PHASE_INGEST,
+	PHASE_KERNING,
+	PHASE_TOTAL,
+	PHASE_COUNT
+} Phase;
+
+static const char *phaseZones[PHASE_COUNT] = {
+	"Wellspring_CreateFont/ParseAtlas",
+	"Wellspring_CreateFont/InitFont",
+	"Wellspring_CreateFont/IngestGlyphs",
+	"Wellspring_CreateFont/LoadKerning",
+	"Wellspring_CreateFont"
+};
+
+static uint64_t phaseStarts[PHASE_COUNT];
+static uint64_t phaseNS[PHASE_COUNT];
+
+static int FindPhase(const char *name)
+{
+	int i;
+
+	for (i = 0; i < PHASE_COUNT; i += 1)
+	{
+		if (strcmp(name, phaseZones[i]) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void WELLSPRINGCALL BeginZone(void *userdata, const char *name)
+{
+	int phase = FindPhase(name);
+
+	if (phase >= 0)
+	{
+		phaseStarts[phase] = SDL_GetTicksNS();
+	}
+}
+
+static void WELLSPRINGCALL EndZone(void *userdata, const char *name)
+{
+	int phase = FindPhase(name);
+
+	if (phase >= 0)
+	{
+		phaseNS[phase] = SDL_GetTicksNS() - phaseStarts[phase];
+	}
+}
+
+/* Cases */
+
+typedef enum KerningSource
+{
+	KERNING_OFF,
+	KERNING_FONT,
+	KERNING_ATLAS,
+	KERNING_SOURCE_COUNT
+} KerningSource;
+
+static const char *kerningSourceNames[KERNING_SOURCE_COUNT] = {
+	"off",
+	"font",
+	"atlas"
+};
+
+static uint32_t MakeCodepoints(uint32_t *codepoints, uint32_t glyphCount, uint8_t fragmented)
+{
+	uint32_t codepoint = 0x20;
+	uint32_t i;
+
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		if (codepoint >= 0xD800 && codepoint < 0xE000)
+		{
+			/* Surrogates aren't valid codepoints */
+			codepoint = 0xE000;
+		}
+
+		codepoints[i] = codepoint;
+
+		/* Fragmented atlases put every glyph in its own range */
+		codepoint += fragmented ? 2 : 1;
+	}
+
+	return glyphCount;
+}
+
+/* Each phase keeps its best time, which filters out scheduling noise */
+static void KeepBest(double *best, Phase phase)
+{
+	double elapsed = (double) phaseNS[phase] / 1e6;
+
+	if (elapsed < *best)
+	{
+		*best = elapsed;
+	}
+}
+
+static void RunCase(uint32_t glyphCount, uint8_t fragmented, KerningSource kerning, uint8_t arena, uint64_t minTimeNS)
+{
+	uint32_t *codepoints = malloc(sizeof(uint32_t) * glyphCount);
+	BenchFixture fixture;
+	Wellspring_Font *font;
+	float pixelsPerEm, distanceRange;
+	double parseMS = 1e30, initMS = 1e30, ingestMS = 1e30, kerningMS = 1e30, totalMS = 1e30;
+	size_t baseBytes, baseBlocks, peakDelta = 0, fontBytes = 0, fontBlocks = 0;
+	uint64_t caseStart;
+	uint32_t repetitions = 0;
+
+	MakeCodepoints(codepoints, glyphCount, fragmented);
+	BenchFixture_Create(
+		codepoints,
+		glyphCount,
+		kerning != KERNING_OFF ? KERNING_PAIRS : 0,
+		kerning == KERNING_ATLAS,
+		&fixture
+	);
+	Wellspring_SetFontArenas(arena);
+
+	caseStart = SDL_GetTicksNS();
+	while (repetitions < MIN_REPETITIONS || SDL_GetTicksNS() - caseStart < minTimeNS)
+	{
+		baseBytes = currentBytes;
+		baseBlocks = currentBlocks;
+		peakBytes = currentBytes;
+		SDL_memset(phaseNS, 0, sizeof(phaseNS));
+
+		font = Wellspring_CreateFont(
+			kerning == KERNING_ATLAS ? NULL : fixture.fontBytes,
+			kerning == KERNING_ATLAS ? 0 : fixture.fontBytesLength,
+			fixture.atlasJsonBytes,
+			fixture.atlasJsonBytesLength,
+			&pixelsPerEm,
+			&distanceRange
+		);
+
+		if (font == NULL)
+		{
+			fprintf(stderr, "Failed to create a font with %u glyphs!\n", glyphCount);
+			break;
+		}
+
+		KeepBest(&parseMS, PHASE_PARSE);
+		KeepBest(&initMS, PHASE_INIT);
+		KeepBest(&ingestMS, PHASE_INGEST);
+		KeepBest(&kerningMS, PHASE_KERNING);
+		KeepBest(&totalMS, PHASE_TOTAL);
+
+		peakDelta = peakBytes - baseBytes;
+		fontBytes = currentBytes - baseBytes;
+		fontBlocks = currentBlocks - baseBlocks;
+
+		Wellspring_DestroyFont(font);
+		repetitions += 1;
+	}
+
+	printf(
+		"%u,%s,%s,%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%llu,%llu,%llu\n",
+		glyphCount,
+		fragmented ? "fragmented" : "dense",
+		kerningSourceNames[kerning],
+		arena ? "on" : "off",
+		fixture.atlasJsonBytesLength,
+		parseMS,
+		initMS,
+		ingestMS,
+		kerningMS,
+		totalMS,
+		(unsigned long long) peakDelta,
+		(unsigned long long) fontBytes,
+		(unsigned long long) fontBlocks
+	);
+	fflush(stdout);
+
+	BenchFixture_Destroy(&fixture);
+	free(codepoints);
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t glyphCounts[] = { 100, 1000, 5000, 20000, 50000 };
+
+	Wellspring_Allocator allocator;
+	Wellspring_ProfilerHooks hooks;
+	uint64_t minTimeNS = 250000000;
+	uint32_t maxGlyphs = 50000;
+	uint32_t i, fragmented, kerning, arena;
+
+	for (i = 1; i < (uint32_t) argc; i += 1)
+	{
+		if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < (uint32_t) argc)
+		{
+			minTimeNS = strtoull(argv[++i], NULL, 10) * 1000000;
+		}
+		else if (strcmp(argv[i], "--max-glyphs") == 0 && i + 1 < (uint32_t) argc)
+		{
+			maxGlyphs = (uint32_t) strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--min-time-ms N] [--max-glyphs N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Has to happen before Wellspring allocates anything */
+	allocator.mallocFunc = CountingMalloc;
+	allocator.reallocFunc = CountingRealloc;
+	allocator.freeFunc = CountingFree;
+	allocator.userdata = NULL;
+	Wellspring_SetAllocator(&allocator);
+
+	hooks.beginZone = BeginZone;
+	hooks.endZone = EndZone;
+	hooks.plot = NULL;
+	hooks.userdata = NULL;
+	Wellspring_SetProfilerHooks(&hooks);
+
+	printf("glyphs,codepoints,kerning,arena,json_bytes,parse_ms,stbtt_init_ms,ingest_ms,kerning_ms,total_ms,peak_heap_bytes,font_heap_bytes,font_allocations\n");
+
+	for (i = 0; i < sizeof(glyphCounts) / sizeof(glyphCounts[0]); i += 1)
+	{
+		if (glyphCounts[i] > maxGlyphs)
+		{
+			continue;
+		}
+
+		for (fragmented = 0; fragmented < 2; fragmented += 1)
+		{
+			for (kerning = 0; kerning < KERNING_SOURCE_COUNT; kerning += 1)
+			{
+				for (arena = 0; arena < 2; arena += 1)
+				{
+					RunCase(glyphCounts[i], (uint8_t) fragmented, (KerningSource) kerning, (uint8_t) arena, minTimeNS);
+				}
+			}
+		}
+	}
+
+	Wellspring_SetProfilerHooks(NULL);
+	Wellspring_SetFontArenas(0);
+	Wellspring_SetAllocator(NULL);
+
+	return 0;
+}
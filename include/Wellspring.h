@@ -46,8 +46,8 @@ extern "C"
 
 /* Version API */
 
-#define WELLSPRING_MAJOR_VERSION 1
-#define WELLSPRING_MINOR_VERSION 1
+#define WELLSPRING_MAJOR_VERSION 2
+#define WELLSPRING_MINOR_VERSION 0
 #define WELLSPRING_PATCH_VERSION 0
 
 #define WELLSPRING_COMPILED_VERSION ( \
@@ -62,6 +62,8 @@ WELLSPRINGAPI uint32_t Wellspring_LinkedVersion(void);
 
 typedef struct Wellspring_Font Wellspring_Font;
 typedef struct Wellspring_TextBatch Wellspring_TextBatch;
+typedef struct Wellspring_TextBatchRing Wellspring_TextBatchRing;
+typedef struct Wellspring_PreparedText Wellspring_PreparedText;
 
 typedef struct Wellspring_FontRange
 {
@@ -71,11 +73,15 @@ typedef struct Wellspring_FontRange
 	uint8_t oversampleV;
 } Wellspring_FontRange;
 
+/* Since 2.0 a vertex is 24 bytes: page was added after chunkIndex, so vertex
+ * layouts and strides written for 1.x need updating.
+ */
 typedef struct Wellspring_Vertex
 {
 	float x, y;
 	float u, v;
 	uint32_t chunkIndex;
+	uint32_t page; /* atlas page of the glyph, 0 for single-page fonts */
 } Wellspring_Vertex;
 
 typedef struct Wellspring_Rectangle
@@ -86,6 +92,41 @@ typedef struct Wellspring_Rectangle
 	float h;
 } Wellspring_Rectangle;
 
+/* A span of vertices in a finalized batch that all sample the same atlas page.
+ * page was added in 2.0, between atlasID and firstVertex.
+ */
+typedef struct Wellspring_DrawRange
+{
+	uint32_t atlasID;
+	uint32_t page;
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+} Wellspring_DrawRange;
+
+typedef struct Wellspring_VertexRange
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+} Wellspring_VertexRange;
+
+/* Reported by compaction: vertices that moved from src to dst */
+typedef struct Wellspring_VertexMove
+{
+	uint32_t srcFirstVertex;
+	uint32_t dstFirstVertex;
+	uint32_t vertexCount;
+} Wellspring_VertexMove;
+
+/* Applied to emitted vertices as scale, then rotation, then translation. */
+typedef struct Wellspring_Transform
+{
+	float translateX;
+	float translateY;
+	float scaleX;
+	float scaleY;
+	float rotation; /* in radians */
+} Wellspring_Transform;
+
 typedef enum Wellspring_HorizontalAlignment
 {
 	WELLSPRING_HORIZONTALALIGNMENT_LEFT,
@@ -101,8 +142,192 @@ typedef enum Wellspring_VerticalAlignment
 	WELLSPRING_VERTICALALIGNMENT_BOTTOM
 } Wellspring_VerticalAlignment;
 
+/* The arguments of one Wellspring_AddChunkToTextBatchWithTransform call */
+typedef struct Wellspring_ChunkDescriptor
+{
+	Wellspring_Font *font;
+	int pixelSize;
+	Wellspring_HorizontalAlignment horizontalAlignment;
+	Wellspring_VerticalAlignment verticalAlignment;
+	const uint8_t *strBytes;
+	uint32_t strLengthInBytes;
+	const Wellspring_Transform *transform; /* can be NULL */
+} Wellspring_ChunkDescriptor;
+
+/* Processes the items in [begin, end). */
+typedef void (WELLSPRINGCALL * Wellspring_ParallelTask)(
+	void *taskData,
+	uint32_t begin,
+	uint32_t end
+);
+
+/* Must split [0, count) into disjoint ranges, call task on every range
+ * (in any order, on any thread), and only return once all of them are done.
+ */
+typedef void (WELLSPRINGCALL * Wellspring_ParallelFor)(
+	void *userdata,
+	uint32_t count,
+	Wellspring_ParallelTask task,
+	void *taskData
+);
+
+typedef void* (WELLSPRINGCALL * Wellspring_MallocFunc)(
+	void *userdata,
+	size_t size
+);
+
+/* Must behave like realloc, including when mem is NULL */
+typedef void* (WELLSPRINGCALL * Wellspring_ReallocFunc)(
+	void *userdata,
+	void *mem,
+	size_t size
+);
+
+typedef void (WELLSPRINGCALL * Wellspring_FreeFunc)(
+	void *userdata,
+	void *mem
+);
+
+typedef struct Wellspring_Allocator
+{
+	Wellspring_MallocFunc mallocFunc;
+	Wellspring_ReallocFunc reallocFunc;
+	Wellspring_FreeFunc freeFunc;
+	void *userdata;
+} Wellspring_Allocator;
+
+/* name always points to the same static string for a given zone or plot,
+ * so hooks can use the pointer as a key. end is called with the name that
+ * was passed to the matching begin.
+ */
+typedef void (WELLSPRINGCALL * Wellspring_ProfileBeginZone)(
+	void *userdata,
+	const char *name
+);
+
+typedef void (WELLSPRINGCALL * Wellspring_ProfileEndZone)(
+	void *userdata,
+	const char *name
+);
+
+typedef void (WELLSPRINGCALL * Wellspring_ProfilePlot)(
+	void *userdata,
+	const char *name,
+	double value
+);
+
+/* Any of the hooks can be NULL */
+typedef struct Wellspring_ProfilerHooks
+{
+	Wellspring_ProfileBeginZone beginZone;
+	Wellspring_ProfileEndZone endZone;
+	Wellspring_ProfilePlot plot;
+	void *userdata;
+} Wellspring_ProfilerHooks;
+
+/* Counted since the batch was created */
+typedef struct Wellspring_TextBatchStats
+{
+	uint64_t glyphsEmitted;
+	uint64_t chunksAdded;
+	uint64_t chunksReused; /* retained chunks whose vertices were kept */
+	uint64_t missingGlyphs; /* codepoints without a glyph, laid out as a space */
+	uint64_t kerningLookups;
+	uint64_t utf8Rejects; /* chunks dropped because they failed to decode */
+	uint64_t reallocations; /* vertex or chunk storage growth */
+	uint32_t peakVertexCapacity;
+	uint32_t peakChunkCapacity;
+} Wellspring_TextBatchStats;
+
+/* Counted since the font was created */
+typedef struct Wellspring_FontStats
+{
+	uint32_t layoutCalls; /* chunks laid out with this font, wraps around */
+	uint32_t missingCodepointCount; /* distinct codepoints that had no glyph */
+	uint64_t missingGlyphs;
+	uint32_t dynamicGlyphs; /* glyphs rasterized into the dynamic page */
+} Wellspring_FontStats;
+
+typedef struct Wellspring_MissingCodepoint
+{
+	uint32_t codepoint;
+	uint32_t count;
+} Wellspring_MissingCodepoint;
+
+/* The dynamic glyph page, see Wellspring_EnableDynamicGlyphs */
+typedef struct Wellspring_DynamicGlyphPage
+{
+	const uint8_t *pixels; /* RGBA8, width * height texels */
+	uint32_t width;
+	uint32_t height;
+	uint32_t top; /* atlas texture row the page starts at */
+} Wellspring_DynamicGlyphPage;
+
+/* Made by Wellspring_BuildAtlas, free with Wellspring_FreeAtlasImage */
+typedef struct Wellspring_AtlasImage
+{
+	uint8_t *pixels; /* RGBA8, width * height texels, top row first */
+	uint32_t width;
+	uint32_t height;
+} Wellspring_AtlasImage;
+
+/* In page texels */
+typedef struct Wellspring_DirtyRect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t w;
+	uint32_t h;
+} Wellspring_DirtyRect;
+
 /* API definition */
 
+/* Memory
+ *
+ * Every allocation Wellspring makes goes through the allocator, including
+ * the ones made by stb_truetype and the JSON parser. The default uses
+ * SDL_malloc, SDL_realloc and SDL_free.
+ * Set it before any other Wellspring call, since objects must be freed by
+ * the allocator that created them. Pass NULL to restore the default.
+ */
+WELLSPRINGAPI void Wellspring_SetAllocator(
+	const Wellspring_Allocator *allocator
+);
+
+/* With font arenas on, each font created afterwards keeps its glyph and kerning
+ * tables in one allocation, which Wellspring_DestroyFont frees at once.
+ * Off by default.
+ */
+WELLSPRINGAPI void Wellspring_SetFontArenas(uint8_t enabled);
+
+/* Profiling
+ *
+ * Zones cover font loading and its phases, adding chunks, measuring text,
+ * finalizing and batch growth. Plots report batch sizes.
+ * The hooks are called from whichever thread is using Wellspring, so they
+ * must be thread-safe if Wellspring is used from several threads.
+ * Set them before any other Wellspring call. Pass NULL to remove them.
+ */
+WELLSPRINGAPI void Wellspring_SetProfilerHooks(
+	const Wellspring_ProfilerHooks *hooks
+);
+
+/* Kerning comes from the atlas JSON's "kerning" array when it has one, in
+ * which case fontBytes may be NULL. Otherwise it is read out of fontBytes
+ * for the glyphs the atlas has. fontBytes is not kept past this call, so the
+ * caller can free it right away.
+ *
+ * Glyph bounds are stored in 16 bits, so atlas pages can be at most 32767
+ * texels on a side and glyph plane bounds must lie within 8 ems of the
+ * origin. Atlases past either limit are rejected.
+ *
+ * A font is read-only once Wellspring_CreateFont returns. Any number of
+ * threads can measure and lay out text with the same font at once, as long as
+ * each thread writes to its own batch. Its statistics counters and its dynamic
+ * glyph page are the only state that changes, and both are synchronized.
+ * Setting the atlas ID, enabling dynamic glyphs or destroying the font must
+ * not happen while another thread uses it.
+ */
 WELLSPRINGAPI Wellspring_Font* Wellspring_CreateFont(
 	const uint8_t *fontBytes,
 	uint32_t fontBytesLength,
@@ -112,14 +337,137 @@ WELLSPRINGAPI Wellspring_Font* Wellspring_CreateFont(
 	float *pDistanceRange
 );
 
-/* Batches are not thread-safe, recommend one batch per thread. */
+/* Like Wellspring_CreateFont, for a glyph set spread over several atlas
+ * textures. Each page is the JSON of one msdf-atlas-gen atlas. All pages must
+ * have the same em size (`atlas.size`) and distance range; page texture width
+ * and height may differ.
+ * Glyphs and their quads carry the index of the page they are on, in the
+ * order the pages are given. If pages share a codepoint, the first page wins.
+ * Metrics come from the first page. Atlas kerning is read from every page
+ * that has it, and pairs may span pages.
+ * Dynamic glyphs go on page 0.
+ */
+WELLSPRINGAPI Wellspring_Font* Wellspring_CreateFontFromPages(
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	const uint8_t *const *atlasJsonBytes,
+	const uint32_t *atlasJsonBytesLengths,
+	uint32_t pageCount,
+	float *pPixelsPerEm,
+	float *pDistanceRange
+);
+
+/* Builds the atlas image and the font in one step, without msdf-atlas-gen or
+ * JSON. Each codepoint the font file has gets a glyph; the others are
+ * skipped, and codepoints may be in any order.
+ * Glyphs are rasterized as single-channel SDFs with pixelsPerEm texels per em
+ * and distanceRange texels of distance from 0 to 1, and the value is written
+ * to all four channels, so the image works with an MSDF shader.
+ * The image is atlasWidth texels wide, or a power of two that fits the
+ * glyphs if atlasWidth is 0, and just tall enough to hold them.
+ * Kerning is read out of fontBytes, which is not kept.
+ * If parallelFor is NULL, rasterizing is split across SDL threads.
+ * Returns NULL on failure.
+ */
+WELLSPRINGAPI Wellspring_Font* Wellspring_BuildAtlas(
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	float pixelsPerEm,
+	float distanceRange,
+	uint32_t atlasWidth,
+	Wellspring_ParallelFor parallelFor,
+	void *userdata,
+	Wellspring_AtlasImage *pImage
+);
+
+/* Every font starts with a unique atlas ID. Give fonts that share their atlas
+ * textures the same ID so their chunks end up in the same draw ranges.
+ */
+WELLSPRINGAPI void Wellspring_SetFontAtlasID(
+	Wellspring_Font *font,
+	uint32_t atlasID
+);
+
+WELLSPRINGAPI uint32_t Wellspring_GetFontAtlasID(
+	Wellspring_Font *font
+);
+
+/* Dynamic glyphs
+ *
+ * Off by default. Once enabled, codepoints missing from the atlas are
+ * rasterized from fontBytes as single-channel SDFs the first time they are
+ * laid out, and packed into a page of pageHeight rows that sits under the
+ * atlas in the same texture. The distance is written to all four channels, so
+ * an MSDF shader samples the page unchanged.
+ * The atlas texture, or page 0's for multi-page fonts, must be pageHeight rows
+ * taller than the atlas image, and this has to be called before the font lays
+ * out any text.
+ * fontBytes is copied. Whitespace and codepoints the font file lacks stay
+ * missing, and dynamic glyphs are not kerned.
+ * Returns 0 on failure.
+ */
+WELLSPRINGAPI uint8_t Wellspring_EnableDynamicGlyphs(
+	Wellspring_Font *font,
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	uint32_t pageHeight
+);
+
+/* Returns 0 if dynamic glyphs are off */
+WELLSPRINGAPI uint8_t Wellspring_GetDynamicGlyphPage(
+	Wellspring_Font *font,
+	Wellspring_DynamicGlyphPage *pPage
+);
+
+/* Writes up to capacity rects that were rasterized since the last call and
+ * forgets them. Upload each one from the page pixels to the atlas texture,
+ * offset by the page's top row. Once returned, a rect's texels never change.
+ * Rects that don't fit in capacity are merged into their bounding rect.
+ * Returns the number of rects written.
+ */
+WELLSPRINGAPI uint32_t Wellspring_TakeDynamicGlyphRects(
+	Wellspring_Font *font,
+	Wellspring_DirtyRect *rects,
+	uint32_t capacity
+);
+
+/* Batches are not thread-safe, recommend one batch per thread.
+ * Per-thread batches can be combined with Wellspring_MergeTextBatches.
+ */
 WELLSPRINGAPI Wellspring_TextBatch* Wellspring_CreateTextBatch(void);
 
+/* Segmented batches store vertices in fixed-size blocks that never move, so
+ * growing the batch never copies existing vertices.
+ * verticesPerSegment is rounded up to a multiple of 4.
+ */
+WELLSPRINGAPI Wellspring_TextBatch* Wellspring_CreateSegmentedTextBatch(
+	uint32_t verticesPerSegment
+);
+
 /* Also restarts the batch */
 WELLSPRINGAPI void Wellspring_StartTextBatch(
 	Wellspring_TextBatch *textBatch
 );
 
+/* Retained batches keep the previous frame's vertices when restarted.
+ * A chunk that is added with the same input at the same position as last
+ * frame is not laid out again, and its vertices are not marked dirty.
+ * Finalizing a retained batch does not reorder vertices, draw ranges only
+ * merge adjacent chunks that share an atlas.
+ */
+WELLSPRINGAPI void Wellspring_SetTextBatchRetained(
+	Wellspring_TextBatch *textBatch,
+	uint8_t retained
+);
+
+/* Grows the batch up front so adding up to vertexCount vertices never reallocates. */
+WELLSPRINGAPI void Wellspring_ReserveTextBatch(
+	Wellspring_TextBatch *textBatch,
+	uint32_t vertexCount
+);
+
 WELLSPRINGAPI uint8_t Wellspring_TextBounds(
 	Wellspring_Font *font,
 	int pixelSize,
@@ -140,14 +488,299 @@ WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatch(
 	uint32_t strLengthInBytes
 );
 
+/* Same as above, but the chunk's vertices are emitted in transformed space.
+ * A NULL transform is the same as calling Wellspring_AddChunkToTextBatch.
+ */
+WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatchWithTransform(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+);
+
+/* UTF-16 and UTF-32 input
+ *
+ * Same as the UTF-8 functions above, for callers whose strings are already
+ * in another encoding. strLength is in code units, not bytes. Unpaired
+ * surrogates and values past U+10FFFF fail the same way invalid UTF-8 does.
+ * transform can be NULL.
+ */
+
+WELLSPRINGAPI uint8_t Wellspring_TextBoundsUTF16(
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint16_t *str,
+	uint32_t strLength,
+	Wellspring_Rectangle *pRectangle
+);
+
+WELLSPRINGAPI uint8_t Wellspring_TextBoundsUTF32(
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint32_t *str,
+	uint32_t strLength,
+	Wellspring_Rectangle *pRectangle
+);
+
+WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatchUTF16(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint16_t *str,
+	uint32_t strLength,
+	const Wellspring_Transform *transform
+);
+
+WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatchUTF32(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint32_t *str,
+	uint32_t strLength,
+	const Wellspring_Transform *transform
+);
+
+/* Prepared text
+ *
+ * For strings drawn every frame. Wellspring_PrepareText decodes the string
+ * once and resolves each codepoint to the font's glyph, so laying out the
+ * prepared text only costs positioning and kerning. The output is identical
+ * to the UTF-8 functions.
+ *
+ * Prepared text belongs to the font it was prepared with, and the font must
+ * outlive it. Returns NULL if the string is not valid UTF-8.
+ */
+
+WELLSPRINGAPI Wellspring_PreparedText* Wellspring_PrepareText(
+	Wellspring_Font *font,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes
+);
+
+WELLSPRINGAPI uint8_t Wellspring_TextBoundsPrepared(
+	Wellspring_PreparedText *preparedText,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	Wellspring_Rectangle *pRectangle
+);
+
+/* transform can be NULL. */
+WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatchPrepared(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_PreparedText *preparedText,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Wellspring_Transform *transform
+);
+
+/* Adds every chunk in order, laying them out in parallel.
+ * The result is identical to calling Wellspring_AddChunkToTextBatchWithTransform
+ * for each descriptor in turn: chunks that fail to decode are skipped and the
+ * others get consecutive chunk indices.
+ * If parallelFor is NULL, the work is split across SDL threads.
+ * Returns 0 if any chunk failed.
+ */
+WELLSPRINGAPI uint8_t Wellspring_AddChunksParallel(
+	Wellspring_TextBatch *textBatch,
+	const Wellspring_ChunkDescriptor *chunks,
+	uint32_t chunkCount,
+	Wellspring_ParallelFor parallelFor,
+	void *userdata
+);
+
+/* Concurrent append
+ *
+ * Any number of threads can add chunks to the same batch at once with
+ * Wellspring_AddChunkToTextBatchConcurrent. No other call may use the batch
+ * until Wellspring_FinalizeTextBatch, which places the concurrently added
+ * chunks after the ones added before them, sorted by orderKey. The result is
+ * identical to adding them serially in that order, so it does not depend on
+ * thread timing as long as every orderKey is unique.
+ * Space is claimed without locking. Reserving enough vertices up front with
+ * Wellspring_ReserveTextBatch avoids stalling the other threads while the
+ * batch grows.
+ */
+
+WELLSPRINGAPI uint8_t Wellspring_AddChunkToTextBatchConcurrent(
+	Wellspring_TextBatch *textBatch,
+	uint64_t orderKey,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+);
+
+/* Chunk handles
+ *
+ * A chunk is identified by its chunkIndex, which is the batch's chunk count
+ * at the time it was added. The index stays valid until the chunk is removed
+ * or the batch is restarted.
+ * Replacing or removing a chunk only costs the length of that chunk: freed
+ * quads are made degenerate and their space is reused by later replacements.
+ * Compaction closes the holes and reports which vertex ranges moved.
+ */
+
+WELLSPRINGAPI uint32_t Wellspring_GetTextBatchChunkCount(
+	Wellspring_TextBatch *textBatch
+);
+
+WELLSPRINGAPI uint8_t Wellspring_ReplaceChunk(
+	Wellspring_TextBatch *textBatch,
+	uint32_t chunkIndex,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+);
+
+WELLSPRINGAPI void Wellspring_RemoveChunk(
+	Wellspring_TextBatch *textBatch,
+	uint32_t chunkIndex
+);
+
+/* The moves are valid until the next call that modifies the batch. */
+WELLSPRINGAPI void Wellspring_CompactTextBatch(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pMoveCount,
+	Wellspring_VertexMove **pMoves
+);
+
+/* Appends every source batch to textBatch, in order. chunkIndex values of the
+ * appended vertices are offset by the number of chunks already in textBatch,
+ * so they stay unique. The source batches are left unchanged.
+ * textBatch must not be one of the sources, nothing is merged if it is.
+ */
+WELLSPRINGAPI void Wellspring_MergeTextBatches(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_TextBatch **sourceTextBatches,
+	uint32_t sourceTextBatchCount
+);
+
+/* Groups the batch's vertices by atlas page, so a batch mixing several fonts
+ * can be drawn with one draw per page. Chunks keep their relative order within
+ * a page. Call after the last chunk is added and before reading buffer data.
+ * Holes left by replacing or removing chunks are packed out. Whenever vertices
+ * move, the whole buffer is marked dirty.
+ * Chunks of multi-page fonts stay contiguous, with their quads grouped by page,
+ * so they add a draw range per page they use.
+ */
+WELLSPRINGAPI void Wellspring_FinalizeTextBatch(
+	Wellspring_TextBatch *textBatch
+);
+
+/* Valid after Wellspring_FinalizeTextBatch, until the batch is restarted. */
+WELLSPRINGAPI void Wellspring_GetDrawRanges(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pDrawRangeCount,
+	Wellspring_DrawRange **pDrawRanges
+);
+
+/* Vertex ranges written since the batch was started, including ranges
+ * changed by replacing, removing or compacting chunks.
+ * For retained batches these are the only ranges that need to be uploaded.
+ */
+WELLSPRINGAPI void Wellspring_GetDirtyRanges(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pDirtyRangeCount,
+	Wellspring_VertexRange **pDirtyRanges
+);
+
+/* For segmented batches this gathers all segments into one buffer.
+ * Use the segment functions below to upload without the copy.
+ */
 WELLSPRINGAPI void Wellspring_GetBufferData(
 	Wellspring_TextBatch *textBatch,
 	uint32_t* pVertexCount,
 	Wellspring_Vertex **pVertexBuffer
 );
 
+/* Segments that hold vertices. Empty batches have none, contiguous batches
+ * with vertices always have one.
+ */
+WELLSPRINGAPI uint32_t Wellspring_GetBufferSegmentCount(
+	Wellspring_TextBatch *textBatch
+);
+
+WELLSPRINGAPI void Wellspring_GetBufferSegment(
+	Wellspring_TextBatch *textBatch,
+	uint32_t segmentIndex,
+	uint32_t *pVertexCount,
+	Wellspring_Vertex **pVertexBuffer
+);
+
+/* Statistics
+ *
+ * Only collected when Wellspring is built with WELLSPRING_STATS, otherwise
+ * these return 0 and zero their output.
+ * Font stats can be read at any time. Batch stats must not be read while
+ * another thread is adding to the batch.
+ */
+
+WELLSPRINGAPI uint8_t Wellspring_GetTextBatchStats(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_TextBatchStats *pStats
+);
+
+WELLSPRINGAPI uint8_t Wellspring_GetFontStats(
+	Wellspring_Font *font,
+	Wellspring_FontStats *pStats
+);
+
+/* Writes up to capacity entries, most frequent first.
+ * Returns the number of entries written.
+ */
+WELLSPRINGAPI uint32_t Wellspring_GetFontMissingCodepoints(
+	Wellspring_Font *font,
+	Wellspring_MissingCodepoint *entries,
+	uint32_t capacity
+);
+
 WELLSPRINGAPI void Wellspring_DestroyTextBatch(Wellspring_TextBatch *textBatch);
+
+/* Batch rings keep one batch per frame in flight, so the CPU can fill one
+ * frame while the GPU still reads the previous ones.
+ * Acquired batches are started and reserved to the peak vertex count of
+ * recently retired frames. Storage beyond that peak is released on retire.
+ * Like batches, rings are not thread-safe.
+ */
+WELLSPRINGAPI Wellspring_TextBatchRing* Wellspring_CreateTextBatchRing(
+	uint32_t framesInFlight
+);
+
+/* Returns NULL if every batch in the ring is still in flight. */
+WELLSPRINGAPI Wellspring_TextBatch* Wellspring_AcquireTextBatch(
+	Wellspring_TextBatchRing *textBatchRing
+);
+
+/* Call when the GPU is done with the oldest acquired batch. */
+WELLSPRINGAPI void Wellspring_RetireTextBatch(
+	Wellspring_TextBatchRing *textBatchRing
+);
+
+WELLSPRINGAPI void Wellspring_DestroyTextBatchRing(Wellspring_TextBatchRing *textBatchRing);
 WELLSPRINGAPI void Wellspring_DestroyFont(Wellspring_Font *font);
+WELLSPRINGAPI void Wellspring_DestroyPreparedText(Wellspring_PreparedText *preparedText);
+WELLSPRINGAPI void Wellspring_FreeAtlasImage(Wellspring_AtlasImage *image);
 
 #ifdef __cplusplus
 }
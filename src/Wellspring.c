@@ -25,13 +25,21 @@
  */
 
 #include "Wellspring.h"
+#include <SDL3/SDL_intrin.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_cpuinfo.h>
 
  /* Function defines */
 
-#define Wellspring_malloc SDL_malloc
-#define Wellspring_realloc SDL_realloc
-#define Wellspring_free SDL_free
+#define Wellspring_malloc Wellspring_INTERNAL_Malloc
+#define Wellspring_realloc Wellspring_INTERNAL_Realloc
+#define Wellspring_free Wellspring_INTERNAL_Free
+#define Wellspring_aligned_alloc Wellspring_INTERNAL_AlignedAlloc
+#define Wellspring_aligned_free Wellspring_INTERNAL_AlignedFree
 #define Wellspring_memcpy SDL_memcpy
+#define Wellspring_memmove SDL_memmove
 #define Wellspring_memset SDL_memset
 #define Wellspring_ifloor(x) ((int) SDL_floorf(x))
 #define Wellspring_iceil(x) ((int) SDL_ceilf(x))
@@ -39,11 +47,17 @@
 #define Wellspring_pow SDL_pow
 #define Wellspring_fmod SDL_fmod
 #define Wellspring_cos SDL_cos
+#define Wellspring_cosf SDL_cosf
+#define Wellspring_sinf SDL_sinf
 #define Wellspring_acos SDL_acos
 #define Wellspring_fabs SDL_fabs
+#define Wellspring_round SDL_round
+#define Wellspring_clamp SDL_clamp
 #define Wellspring_assert SDL_assert
 #define Wellspring_strlen SDL_strlen
 #define Wellspring_sort SDL_qsort
+#define Wellspring_min SDL_min
+#define Wellspring_max SDL_max
 
 #define STBTT_malloc(x,u) ((void)(u),Wellspring_malloc(x))
 #define STBTT_free(x,u) ((void)(u),Wellspring_free(x))
@@ -66,6 +80,72 @@
 #define SHEREDOM_JSON_H_malloc Wellspring_malloc
 #define SHEREDOM_JSON_H_free Wellspring_free
 
+/* Allocator, declared ahead of the libraries that use it */
+
+static void* WELLSPRINGCALL Wellspring_INTERNAL_DefaultMalloc(void *userdata, size_t size)
+{
+	(void) userdata;
+	return SDL_malloc(size);
+}
+
+static void* WELLSPRINGCALL Wellspring_INTERNAL_DefaultRealloc(void *userdata, void *mem, size_t size)
+{
+	(void) userdata;
+	return SDL_realloc(mem, size);
+}
+
+static void WELLSPRINGCALL Wellspring_INTERNAL_DefaultFree(void *userdata, void *mem)
+{
+	(void) userdata;
+	SDL_free(mem);
+}
+
+static Wellspring_Allocator allocator = {
+	Wellspring_INTERNAL_DefaultMalloc,
+	Wellspring_INTERNAL_DefaultRealloc,
+	Wellspring_INTERNAL_DefaultFree,
+	NULL
+};
+
+static inline void* Wellspring_INTERNAL_Malloc(size_t size)
+{
+	return allocator.mallocFunc(allocator.userdata, size);
+}
+
+static inline void* Wellspring_INTERNAL_Realloc(void *mem, size_t size)
+{
+	return allocator.reallocFunc(allocator.userdata, mem, size);
+}
+
+static inline void Wellspring_INTERNAL_Free(void *mem)
+{
+	allocator.freeFunc(allocator.userdata, mem);
+}
+
+/* Over-allocates and keeps the original pointer just below the aligned one */
+static void* Wellspring_INTERNAL_AlignedAlloc(size_t alignment, size_t size)
+{
+	uint8_t *block = Wellspring_INTERNAL_Malloc(size + alignment + sizeof(void*));
+	uint8_t *aligned;
+
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	aligned = (uint8_t*) (((uintptr_t) (block + sizeof(void*)) + alignment - 1) & ~(uintptr_t) (alignment - 1));
+	((void**) aligned)[-1] = block;
+	return aligned;
+}
+
+static void Wellspring_INTERNAL_AlignedFree(void *mem)
+{
+	if (mem != NULL)
+	{
+		Wellspring_INTERNAL_Free(((void**) mem)[-1]);
+	}
+}
+
 typedef uint8_t stbtt_uint8;
 typedef int8_t stbtt_int8;
 typedef uint16_t stbtt_uint16;
@@ -88,36 +168,140 @@ typedef int32_t stbtt_int32;
 #pragma GCC diagnostic warning "-Wunused-function"
 
 #define INITIAL_QUAD_CAPACITY 128
+#define RING_PEAK_WINDOW 64
+#define VERTEX_ALIGNMENT 16
+#define ARENA_ALIGNMENT 16
+#define ATLAS_UNITS_PER_TEXEL 2 /* msdf-atlas-gen bounds fall on whole or half texels */
+#define PLANE_UNITS_PER_EM 4096
+#define ATLAS_MAX_SIZE (UINT16_MAX / ATLAS_UNITS_PER_TEXEL) /* atlas rects are stored in 16 bits */
+#define PARALLEL_MAX_THREADS 16
+#define PARALLEL_MIN_ITEMS_PER_THREAD 256
 
 /* Structs */
 
-typedef struct PackedChar
+#define GLYPH_FLAG_WHITESPACE 0x1
+#define GLYPH_FLAG_KERNING 0x2 /* first glyph of at least one kerning pair */
+
+/* Everything measuring and kerning read, 16 bytes.
+ * The atlas rects are kept apart so measurement never pulls them into cache.
+ */
+typedef struct GlyphMetrics
 {
-	float atlasLeft, atlasTop, atlasRight, atlasBottom;
-	float planeLeft, planeTop, planeRight, planeBottom;
+	int16_t planeLeft, planeTop, planeRight, planeBottom; /* ink extents, in 1/PLANE_UNITS_PER_EM ems */
 	float xAdvance;
-} PackedChar;
+	uint16_t flags;
+	uint16_t page; /* index into the packer's atlas pages */
+} GlyphMetrics;
+
+/* Only read when emitting quads, 8 bytes */
+typedef struct AtlasRect
+{
+	uint16_t left, top, right, bottom; /* in 1/ATLAS_UNITS_PER_TEXEL texels */
+} AtlasRect;
 
 typedef struct CharRange
 {
-	PackedChar *data;
+	GlyphMetrics *data;
 	uint32_t firstCodepoint;
 	uint32_t charCount;
 } CharRange;
 
-typedef struct Packer
+/* One atlas texture. A font's glyphs can be spread over several. */
+typedef struct AtlasPage
 {
 	uint32_t width;
 	uint32_t height;
+	float atlasScaleX; /* texture coordinate per atlas unit */
+	float atlasScaleY;
+} AtlasPage;
+
+typedef struct Packer
+{
+	AtlasPage *pages;
+	uint32_t pageCount;
 
+	GlyphMetrics *metrics; /* every range points into this */
+	AtlasRect *atlasRects; /* indexed like metrics, in the same allocation */
+	uint32_t glyphCount;
 	CharRange *ranges;
 	uint32_t rangeCount;
 } Packer;
 
-typedef struct Font
+#define KERNING_EMPTY_GLYPH UINT32_MAX
+#define KERNING_INITIAL_CAPACITY 64
+#define KERNING_MIN_GLYPHS_PER_THREAD 512 /* first glyphs per GPOS worker */
+
+typedef struct KerningPair
+{
+	uint32_t first; /* KERNING_EMPTY_GLYPH when unused */
+	uint32_t second;
+	float advance;
+} KerningPair;
+
+typedef struct KerningTable
+{
+	KerningPair *pairs; /* open addressing, at most three quarters full */
+	uint32_t count;
+	uint32_t capacity;
+} KerningTable;
+
+#define DYNAMIC_MAX_DIRTY_RECTS 64
+#define DYNAMIC_INITIAL_ENTRY_CAPACITY 64
+#define DYNAMIC_EMPTY_CODEPOINT UINT32_MAX
+
+typedef struct DynamicEntry
+{
+	uint32_t codepoint; /* DYNAMIC_EMPTY_CODEPOINT when unused */
+	uint32_t index; /* into the dynamic glyph tables, GLYPH_SLOT_NONE if it couldn't be rasterized */
+} DynamicEntry;
+
+#define SDF_ON_EDGE_VALUE 128
+
+/* Turns outlines into SDFs encoded like the atlas */
+typedef struct SdfRasterizer
+{
+	const stbtt_fontinfo *fontInfo;
+	float sdfScale; /* font units to texels */
+	float emScale; /* font units to ems */
+	float distanceScale; /* SDF value per texel of distance */
+	float texelSize; /* in ems */
+	int padding;
+} SdfRasterizer;
+
+/* Glyphs rasterized at runtime into a page under atlas page 0 */
+typedef struct DynamicGlyphs
 {
 	uint8_t *fontBytes;
 	stbtt_fontinfo fontInfo;
+	SdfRasterizer rasterizer;
+
+	uint32_t top;
+	uint32_t width;
+	uint32_t height;
+	uint8_t *pixels;
+	stbrp_context packContext;
+	stbrp_node *packNodes;
+	uint8_t full;
+
+	/* Held for reading while looking up, for writing while rasterizing */
+	SDL_RWLock *lock;
+	DynamicEntry *entries; /* open addressing, at most half full */
+	uint32_t entryCount;
+	uint32_t entryCapacity;
+
+	/* Sized up front so glyphs never move once layout has seen them */
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRects; /* in the same allocation */
+	uint32_t glyphCount;
+	uint32_t glyphCapacity;
+
+	Wellspring_DirtyRect dirtyRects[DYNAMIC_MAX_DIRTY_RECTS];
+	uint32_t dirtyRectCount;
+} DynamicGlyphs;
+
+typedef struct Font
+{
+	uint8_t arena; /* the glyph and kerning tables live in the font's own allocation */
 
 	float ascender;
 	float descender;
@@ -126,26 +310,148 @@ typedef struct Font
 	float distanceRange;
 
 	float scale;
-	float kerningScale; // kerning values from stb_tt are in a different scale
+	float kerningScale; // kerning values from the font file are in a different scale, atlas kerning is already in ems
+
+	uint32_t atlasID;
 
-	Packer packer;
+	Packer packer; /* the height of page 0 includes the dynamic page */
+	KerningTable kerning; /* keyed by glyph table index */
+	DynamicGlyphs *dynamic; /* NULL unless dynamic glyphs are on */
+
+	/* Statistics, updated by every thread that lays out with this font */
+	SDL_AtomicInt layoutCalls;
+	SDL_SpinLock missingLock;
+	Wellspring_MissingCodepoint *missingCodepoints; /* open addressing, empty entries have a count of 0 */
+	uint32_t missingCodepointCount;
+	uint32_t missingCodepointCapacity;
+	uint64_t missingGlyphs;
 } Font;
 
+typedef struct Chunk
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t vertexCapacity; /* size of the chunk's slot, unused quads are degenerate */
+	uint32_t atlasID;
+	uint64_t hash; /* only computed for retained batches */
+	uint64_t orderKey; /* only used for concurrently added chunks */
+	uint8_t removed;
+	uint8_t multiPage; /* its quads can be on different atlas pages */
+} Chunk;
+
+/* Everything besides the string that affects a chunk's vertices */
+typedef struct ChunkKey
+{
+	const Font *font;
+	uint32_t atlasID;
+	int pixelSize;
+	Wellspring_HorizontalAlignment horizontalAlignment;
+	Wellspring_VerticalAlignment verticalAlignment;
+	uint32_t strLengthInBytes;
+	uint32_t encoding;
+	uint32_t hasTransform;
+	Wellspring_Transform transform;
+} ChunkKey;
+
+/* Per-descriptor state of a Wellspring_AddChunksParallel call */
+typedef struct ParallelChunk
+{
+	uint32_t quadCount;
+	uint32_t firstVertex;
+	uint32_t chunkIndex;
+	uint64_t hash;
+	uint8_t valid;
+	uint8_t fill; /* 0 if the chunk failed or its retained vertices were reused */
+} ParallelChunk;
+
 typedef struct Batch
 {
-	Wellspring_Vertex *vertices;
+	Wellspring_Vertex *vertices; /* NULL for segmented batches */
 	uint32_t vertexCount;
 	uint32_t vertexCapacity;
 
+	/* Segmented storage: fixed-size blocks that never move once allocated */
+	Wellspring_Vertex **segments;
+	uint32_t segmentCount;
+	uint32_t segmentCapacity;
+	uint32_t verticesPerSegment; /* 0 for contiguous batches */
+
+	/* Contiguous copy of a segmented batch, for GetBufferData, also used as sort scratch */
+	Wellspring_Vertex *gatherVertices;
+	uint32_t gatherCapacity;
+
+	Chunk *chunks;
 	uint32_t chunkCount;
+	uint32_t chunkCapacity;
+
+	Wellspring_DrawRange *drawRanges;
+	uint32_t drawRangeCount;
+	uint32_t drawRangeCapacity;
+
+	/* Retained batches keep the previous frame's chunks to compare against */
+	uint8_t retained;
+	uint32_t retainedChunkCount;
+	uint32_t retainedVertexCount;
+
+	Wellspring_VertexRange *dirtyRanges;
+	uint32_t dirtyRangeCount;
+	uint32_t dirtyRangeCapacity;
+
+	/* Slots of removed or relocated chunks, reused first-fit */
+	Wellspring_VertexRange *freeRanges;
+	uint32_t freeRangeCount;
+	uint32_t freeRangeCapacity;
+
+	/* Compaction scratch and output */
+	Chunk **compactOrder;
+	uint32_t compactOrderCapacity;
+	Wellspring_VertexMove *moves;
+	uint32_t moveCount;
+	uint32_t moveCapacity;
+
+	/* Parallel layout scratch */
+	ParallelChunk *parallelChunks;
+	uint32_t parallelChunkCapacity;
+
+	/* Concurrent appends claim space past vertexCount and chunkCount until the batch is finalized */
+	SDL_AtomicInt concurrentVertexCount;
+	SDL_AtomicInt concurrentChunkCount;
+	SDL_RWLock *growLock; /* held for reading while appending, for writing while growing */
+
+	Wellspring_TextBatchStats stats;
+	SDL_SpinLock statsLock; /* only needed while threads add to the batch at once */
 } Batch;
 
+typedef struct BatchRing
+{
+	Batch **batches;
+	uint32_t batchCount;
+	uint32_t nextBatch;
+	uint32_t inFlightCount;
+
+	/* Vertex counts of recently retired frames, shared by every batch in the ring */
+	uint32_t retiredVertexCounts[RING_PEAK_WINDOW];
+	uint32_t retiredFrameCount;
+	uint32_t peakVertexCount;
+} BatchRing;
+
 typedef struct Quad
 {
-   float x0,y0,s0,t0; // top-left
-   float x1,y1,s1,t1; // bottom-right
+   float x0,y0; // top-left
+   float x1,y1; // bottom-right
 } Quad;
 
+/* x' = m11 * x + m21 * y + dx, y' = m12 * x + m22 * y + dy */
+typedef struct Affine
+{
+	float m11, m12;
+	float m21, m22;
+	float dx, dy;
+} Affine;
+
+/* Default atlas IDs, unique per font */
+static SDL_AtomicInt nextAtlasID;
+
 /* UTF-8 Decoder */
 
 /* Copyright (c) 2008-2009 Bjoern Hoehrmann <bjoern@hoehrmann.de>
@@ -184,6 +490,254 @@ decode(uint32_t* state, uint32_t* codep, uint32_t byte) {
 	return *state;
 }
 
+/* Returns how many bytes at the start of bytes are ASCII */
+static inline uint32_t Wellspring_INTERNAL_AsciiSpan(const uint8_t *bytes, uint32_t length)
+{
+	uint32_t span = 0;
+
+#if defined(SDL_SSE2_INTRINSICS)
+	while (span + 16 <= length)
+	{
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (bytes + span))) != 0)
+		{
+			break;
+		}
+		span += 16;
+	}
+#elif defined(SDL_NEON_INTRINSICS)
+	uint8x16_t block;
+	uint8x8_t folded;
+
+	while (span + 16 <= length)
+	{
+		block = vld1q_u8(bytes + span);
+		folded = vorr_u8(vget_low_u8(block), vget_high_u8(block));
+		if ((vget_lane_u64(vreinterpret_u64_u8(folded), 0) & 0x8080808080808080ull) != 0)
+		{
+			break;
+		}
+		span += 16;
+	}
+#endif
+
+	/* The rest of the string, or the block that had a non-ASCII byte */
+	while (span < length && bytes[span] < 0x80)
+	{
+		span += 1;
+	}
+
+	return span;
+}
+
+/* Same as decode for strBytes[i], but whole ASCII runs are found up front
+ * and skip the DFA. *pAsciiEnd must start at 0.
+ */
+static inline uint32_t Wellspring_INTERNAL_DecodeByte(
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	uint32_t i,
+	uint32_t *pAsciiEnd,
+	uint32_t *pDecodeState,
+	uint32_t *pCodepoint
+) {
+	if (i < *pAsciiEnd)
+	{
+		*pCodepoint = strBytes[i];
+		return UTF8_ACCEPT;
+	}
+
+	/* ASCII in the middle of a multi-byte sequence is still rejected by the DFA */
+	if (*pDecodeState == UTF8_ACCEPT && strBytes[i] < 0x80)
+	{
+		*pAsciiEnd = i + Wellspring_INTERNAL_AsciiSpan(strBytes + i, strLengthInBytes - i);
+		*pCodepoint = strBytes[i];
+		return UTF8_ACCEPT;
+	}
+
+	return decode(pDecodeState, pCodepoint, strBytes[i]);
+}
+
+/* Text input */
+
+typedef enum TextEncoding
+{
+	TEXT_ENCODING_UTF8,
+	TEXT_ENCODING_UTF16,
+	TEXT_ENCODING_UTF32,
+	TEXT_ENCODING_GLYPHS /* an array of GlyphSlot from Wellspring_PrepareText */
+} TextEncoding;
+
+typedef enum GlyphType
+{
+	GLYPH_TYPE_VISIBLE,
+	GLYPH_TYPE_WHITESPACE,
+	GLYPH_TYPE_NEWLINE,
+	GLYPH_TYPE_MISSING,
+	GLYPH_TYPE_DYNAMIC /* visible, from the dynamic page, never kerned */
+} GlyphType;
+
+/* A prepared glyph, 8 bytes */
+typedef struct GlyphSlot
+{
+	uint32_t value; /* index into the font's or the dynamic page's glyph tables, or the codepoint of a missing glyph */
+	uint8_t type;
+	uint8_t padding[3];
+} GlyphSlot;
+
+/* What the layout loops work on, whatever the input was */
+typedef struct ResolvedGlyph
+{
+	GlyphType type;
+	uint32_t codepoint; /* only set for text that wasn't prepared */
+	GlyphMetrics *metrics; /* NULL for newlines and missing glyphs */
+} ResolvedGlyph;
+
+/* The one rule for which glyphs get a quad, so counting and layout agree */
+static inline uint8_t Wellspring_INTERNAL_EmitsQuad(GlyphType type)
+{
+	return type == GLYPH_TYPE_VISIBLE || type == GLYPH_TYPE_DYNAMIC;
+}
+
+typedef struct PreparedText
+{
+	Font *font;
+	GlyphSlot *slots;
+	uint32_t slotCount;
+} PreparedText;
+
+/* A string as the caller passed it, every layout path reads through this */
+typedef struct Text
+{
+	const void *data;
+	uint32_t length; /* in code units */
+	TextEncoding encoding;
+} Text;
+
+typedef struct TextReader
+{
+	const void *data;
+	uint32_t length;
+	TextEncoding encoding;
+	uint32_t index;
+	uint32_t asciiEnd;
+	uint32_t decodeState;
+	uint8_t rejected;
+} TextReader;
+
+static inline Text Wellspring_INTERNAL_MakeText(const void *data, uint32_t length, TextEncoding encoding)
+{
+	Text text;
+	text.data = data;
+	text.length = length;
+	text.encoding = encoding;
+	return text;
+}
+
+static inline uint32_t Wellspring_INTERNAL_TextSizeInBytes(const Text *text)
+{
+	return text->length * (
+		text->encoding == TEXT_ENCODING_UTF8 ? 1 :
+		text->encoding == TEXT_ENCODING_UTF16 ? 2 :
+		text->encoding == TEXT_ENCODING_UTF32 ? 4 :
+		(uint32_t) sizeof(GlyphSlot)
+	);
+}
+
+static inline void Wellspring_INTERNAL_StartReading(TextReader *reader, const Text *text)
+{
+	reader->data = text->data;
+	reader->length = text->length;
+	reader->encoding = text->encoding;
+	reader->index = 0;
+	reader->asciiEnd = 0;
+	reader->decodeState = UTF8_ACCEPT;
+	reader->rejected = 0;
+}
+
+/* Returns 0 at the end of the text, or at invalid input, which also sets rejected.
+ * Like truncated UTF-8, a truncated UTF-16 surrogate pair at the very end is ignored.
+ */
+static inline uint8_t Wellspring_INTERNAL_ReadCodepoint(TextReader *reader, uint32_t *pCodepoint)
+{
+	const uint16_t *units;
+	uint32_t high, low, state;
+
+	if (reader->encoding == TEXT_ENCODING_UTF8)
+	{
+		while (reader->index < reader->length)
+		{
+			state = Wellspring_INTERNAL_DecodeByte(
+				(const uint8_t*) reader->data,
+				reader->length,
+				reader->index,
+				&reader->asciiEnd,
+				&reader->decodeState,
+				pCodepoint
+			);
+			reader->index += 1;
+
+			if (state == UTF8_ACCEPT)
+			{
+				return 1;
+			}
+
+			if (state == UTF8_REJECT)
+			{
+				reader->rejected = 1;
+				return 0;
+			}
+		}
+
+		return 0;
+	}
+
+	if (reader->index >= reader->length)
+	{
+		return 0;
+	}
+
+	if (reader->encoding == TEXT_ENCODING_UTF32)
+	{
+		*pCodepoint = ((const uint32_t*) reader->data)[reader->index];
+		reader->index += 1;
+
+		if (*pCodepoint > 0x10FFFF || (*pCodepoint >= 0xD800 && *pCodepoint < 0xE000))
+		{
+			reader->rejected = 1;
+			return 0;
+		}
+
+		return 1;
+	}
+
+	units = (const uint16_t*) reader->data;
+	high = units[reader->index];
+	reader->index += 1;
+
+	if (high < 0xD800 || high >= 0xE000)
+	{
+		*pCodepoint = high;
+		return 1;
+	}
+
+	if (reader->index == reader->length && high < 0xDC00)
+	{
+		return 0;
+	}
+
+	low = reader->index < reader->length ? units[reader->index] : 0;
+	if (high >= 0xDC00 || low < 0xDC00 || low >= 0xE000)
+	{
+		/* Unpaired surrogate */
+		reader->rejected = 1;
+		return 0;
+	}
+
+	reader->index += 1;
+	*pCodepoint = 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+	return 1;
+}
+
 /* JSON helpers */
 
 static uint8_t json_object_has_key(const json_object_t *object, const char* name)
@@ -311,213 +865,163 @@ uint32_t Wellspring_LinkedVersion(void)
 	return WELLSPRING_COMPILED_VERSION;
 }
 
-Wellspring_Font* Wellspring_CreateFont(
-	const uint8_t* fontBytes,
-	uint32_t fontBytesLength,
-	const uint8_t *atlasJsonBytes,
-	uint32_t atlasJsonBytesLength,
-	float *pPixelsPerEm,
-	float *pDistanceRange
-) {
-	Font *font = Wellspring_malloc(sizeof(Font));
-
-	font->fontBytes = Wellspring_malloc(fontBytesLength);
-	Wellspring_memcpy(font->fontBytes, fontBytes, fontBytesLength);
-	stbtt_InitFont(&font->fontInfo, font->fontBytes, 0);
-	int stbAscender, stbDescender, stbLineHeight;
-	stbtt_GetFontVMetrics(&font->fontInfo, &stbAscender, &stbDescender, &stbLineHeight);
+/* Memory */
 
-	json_value_t *jsonRoot = json_parse(atlasJsonBytes, atlasJsonBytesLength);
-	json_object_t *jsonObject = jsonRoot->payload;
+static uint8_t fontArenas = 0;
 
-	if (jsonObject == NULL)
+void Wellspring_SetAllocator(
+	const Wellspring_Allocator *newAllocator
+) {
+	if (newAllocator == NULL)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas JSON is invalid! Bailing!");
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
+		allocator.mallocFunc = Wellspring_INTERNAL_DefaultMalloc;
+		allocator.reallocFunc = Wellspring_INTERNAL_DefaultRealloc;
+		allocator.freeFunc = Wellspring_INTERNAL_DefaultFree;
+		allocator.userdata = NULL;
+		return;
 	}
 
-	if (SDL_strcmp(jsonObject->start->name->string, "atlas") != 0)
+	allocator = *newAllocator;
+}
+
+void Wellspring_SetFontArenas(uint8_t enabled)
+{
+	fontArenas = enabled;
+}
+
+/* Profiling */
+
+static Wellspring_ProfilerHooks profilerHooks;
+
+/* Zone and plot names, each one is a single static string */
+static const char ZONE_CREATE_FONT[] = "Wellspring_CreateFont";
+static const char ZONE_INIT_FONT[] = "Wellspring_CreateFont/InitFont";
+static const char ZONE_PARSE_ATLAS[] = "Wellspring_CreateFont/ParseAtlas";
+static const char ZONE_INGEST_GLYPHS[] = "Wellspring_CreateFont/IngestGlyphs";
+static const char ZONE_LOAD_KERNING[] = "Wellspring_CreateFont/LoadKerning";
+static const char ZONE_RASTERIZE_GLYPH[] = "Wellspring_RasterizeGlyph";
+static const char ZONE_BUILD_ATLAS[] = "Wellspring_BuildAtlas";
+static const char ZONE_RASTERIZE_ATLAS[] = "Wellspring_BuildAtlas/Rasterize";
+static const char ZONE_PACK_ATLAS[] = "Wellspring_BuildAtlas/Pack";
+static const char ZONE_TEXT_BOUNDS[] = "Wellspring_TextBounds";
+static const char ZONE_PREPARE_TEXT[] = "Wellspring_PrepareText";
+static const char ZONE_ADD_CHUNK[] = "Wellspring_AddChunkToTextBatch";
+static const char ZONE_ADD_CHUNKS_PARALLEL[] = "Wellspring_AddChunksParallel";
+static const char ZONE_FINALIZE[] = "Wellspring_FinalizeTextBatch";
+static const char ZONE_GROW_BATCH[] = "Wellspring_GrowTextBatch";
+static const char PLOT_FONT_GLYPHS[] = "Wellspring font glyphs";
+static const char PLOT_VERTEX_CAPACITY[] = "Wellspring vertex capacity";
+static const char PLOT_BATCH_VERTICES[] = "Wellspring batch vertices";
+
+void Wellspring_SetProfilerHooks(
+	const Wellspring_ProfilerHooks *hooks
+) {
+	if (hooks == NULL)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas JSON is invalid! Bailing!");
-		Wellspring_free(jsonRoot);
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
+		Wellspring_memset(&profilerHooks, 0, sizeof(Wellspring_ProfilerHooks));
+		return;
 	}
 
-	json_object_t *atlasObject = json_object_get_object(jsonObject, "atlas");
-	if (atlasObject == NULL) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
-		Wellspring_free(jsonRoot);
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
-	}
+	profilerHooks = *hooks;
+}
 
-	json_object_t *metricsObject = json_object_get_object(jsonObject, "metrics");
-	if (metricsObject == NULL) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
-		Wellspring_free(jsonRoot);
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
+/* Only called around whole operations, never per glyph */
+static inline void Wellspring_INTERNAL_BeginZone(const char *name)
+{
+	if (profilerHooks.beginZone != NULL)
+	{
+		profilerHooks.beginZone(profilerHooks.userdata, name);
 	}
+}
 
-	json_array_t *glyphsArray = json_value_as_array(json_object_get_element_by_name(jsonObject, "glyphs")->value);
-	if (glyphsArray == NULL) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
-		Wellspring_free(jsonRoot);
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
+static inline void Wellspring_INTERNAL_EndZone(const char *name)
+{
+	if (profilerHooks.endZone != NULL)
+	{
+		profilerHooks.endZone(profilerHooks.userdata, name);
 	}
+}
 
-	const char* atlasType = json_object_get_string(atlasObject, "type");
-
-	if (SDL_strcmp(atlasType, "msdf") != 0)
+static inline void Wellspring_INTERNAL_Plot(const char *name, double value)
+{
+	if (profilerHooks.plot != NULL)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas is not MSDF! Bailing!");
-		Wellspring_free(jsonRoot);
-		Wellspring_free(font->fontBytes);
-		Wellspring_free(font);
-		return NULL;
+		profilerHooks.plot(profilerHooks.userdata, name, value);
 	}
+}
 
-	font->packer.width = json_object_get_uint(atlasObject, "width");
-	font->packer.height = json_object_get_uint(atlasObject, "height");
-	font->pixelsPerEm = json_object_get_double(atlasObject, "size");
-	font->distanceRange = json_object_get_double(atlasObject, "distanceRange");
-
-	font->ascender = json_object_get_double(metricsObject, "ascender");
-	font->descender = json_object_get_double(metricsObject, "descender");
-	font->lineHeight = json_object_get_double(metricsObject, "lineHeight");
+/* Parallel for */
 
-	font->scale = font->pixelsPerEm * 4 / 3; // converting from "points" (dpi) to pixels
+typedef struct ParallelRange
+{
+	Wellspring_ParallelTask task;
+	void *taskData;
+	uint32_t begin;
+	uint32_t end;
+} ParallelRange;
 
-	/* Pack unicode ranges */
+static int SDLCALL Wellspring_INTERNAL_ParallelThread(void *data)
+{
+	ParallelRange *range = (ParallelRange*) data;
+	range->task(range->taskData, range->begin, range->end);
+	return 0;
+}
 
-	font->packer.ranges = Wellspring_malloc(sizeof(CharRange));
-	font->packer.rangeCount = 1;
-	font->packer.ranges[0].data = NULL;
-	font->packer.ranges[0].charCount = 0;
+/* Splits the items into contiguous ranges, one per thread. The calling thread takes the first. */
+static void Wellspring_INTERNAL_RunParallel(
+	uint32_t count,
+	uint32_t minItemsPerThread,
+	Wellspring_ParallelTask task,
+	void *taskData
+) {
+	ParallelRange ranges[PARALLEL_MAX_THREADS];
+	SDL_Thread *threads[PARALLEL_MAX_THREADS];
+	uint32_t threadCount, i;
 
-	int32_t charRangeIndex = 0;
+	threadCount = Wellspring_min((uint32_t) SDL_GetNumLogicalCPUCores(), count / minItemsPerThread);
+	threadCount = Wellspring_max(Wellspring_min(threadCount, PARALLEL_MAX_THREADS), 1);
 
-	json_array_element_t *currentGlyphElement = glyphsArray->start;
-	while (currentGlyphElement != NULL)
+	for (i = 0; i < threadCount; i += 1)
 	{
-		json_object_t *currentGlyphObject = json_value_as_object(currentGlyphElement->value);
-
-		uint32_t codepoint = json_object_get_uint(currentGlyphObject, "unicode");
+		ranges[i].task = task;
+		ranges[i].taskData = taskData;
+		ranges[i].begin = (uint32_t) (((uint64_t) count * i) / threadCount);
+		ranges[i].end = (uint32_t) (((uint64_t) count * (i + 1)) / threadCount);
+	}
 
-		if (font->packer.ranges[charRangeIndex].charCount == 0)
-		{
-			// first codepoint on first range
-			font->packer.ranges[charRangeIndex].firstCodepoint = codepoint;
-		}
-		else if (codepoint != font->packer.ranges[charRangeIndex].firstCodepoint + font->packer.ranges[charRangeIndex].charCount)
+	for (i = 1; i < threadCount; i += 1)
+	{
+		threads[i] = SDL_CreateThread(Wellspring_INTERNAL_ParallelThread, "Wellspring", &ranges[i]);
+		if (threads[i] == NULL)
 		{
-			// codepoint is not continuous, start a new range
-			charRangeIndex += 1;
-			font->packer.rangeCount += 1;
-
-			font->packer.ranges = Wellspring_realloc(font->packer.ranges, sizeof(CharRange) * (charRangeIndex + 1));
-			font->packer.ranges[charRangeIndex].data = NULL;
-			font->packer.ranges[charRangeIndex].firstCodepoint = codepoint;
-			font->packer.ranges[charRangeIndex].charCount = 0;
+			/* Couldn't start a thread, do its share here instead */
+			Wellspring_INTERNAL_ParallelThread(&ranges[i]);
 		}
+	}
 
-		font->packer.ranges[charRangeIndex].charCount += 1;
-		font->packer.ranges[charRangeIndex].data = Wellspring_realloc(font->packer.ranges[charRangeIndex].data, sizeof(PackedChar) * font->packer.ranges[charRangeIndex].charCount);
-
-		PackedChar *packedChar = &font->packer.ranges[charRangeIndex].data[font->packer.ranges[charRangeIndex].charCount - 1];
-		packedChar->atlasLeft = 0;
-		packedChar->atlasRight = 0;
-		packedChar->atlasTop = 0;
-		packedChar->atlasBottom = 0;
-		packedChar->planeLeft = 0;
-		packedChar->planeRight = 0;
-		packedChar->planeTop = 0;
-		packedChar->planeBottom = 0;
-
-		packedChar->xAdvance = json_object_get_double(currentGlyphObject, "advance");
+	Wellspring_INTERNAL_ParallelThread(&ranges[0]);
 
-		if (json_object_has_key(currentGlyphObject, "atlasBounds"))
+	for (i = 1; i < threadCount; i += 1)
+	{
+		if (threads[i] != NULL)
 		{
-			json_object_t *boundsObject = json_object_get_object(currentGlyphObject, "atlasBounds");
-
-			packedChar->atlasLeft = json_object_get_double(boundsObject, "left");
-			packedChar->atlasRight = json_object_get_double(boundsObject, "right");
-			packedChar->atlasTop = json_object_get_double(boundsObject, "top");
-			packedChar->atlasBottom = json_object_get_double(boundsObject, "bottom");
-
-			json_object_t *planeObject = json_object_get_object(currentGlyphObject, "planeBounds");
-
-			packedChar->planeLeft = json_object_get_double(planeObject, "left");
-			packedChar->planeRight = json_object_get_double(planeObject, "right");
-			packedChar->planeTop = json_object_get_double(planeObject, "top");
-			packedChar->planeBottom = json_object_get_double(planeObject, "bottom");
+			SDL_WaitThread(threads[i], NULL);
 		}
-
-		currentGlyphElement = currentGlyphElement->next;
 	}
-
-	int advanceWidth, bearing;
-	stbtt_GetCodepointHMetrics(&font->fontInfo, font->packer.ranges[0].firstCodepoint, &advanceWidth, &bearing);
-
-	font->kerningScale = font->packer.ranges[0].data[0].xAdvance / advanceWidth;
-
-	Wellspring_free(jsonRoot);
-
-	*pPixelsPerEm = font->pixelsPerEm;
-	*pDistanceRange = font->distanceRange;
-
-	return (Wellspring_Font*) font;
 }
 
-Wellspring_TextBatch* Wellspring_CreateTextBatch(void)
-{
-	Batch *batch = Wellspring_malloc(sizeof(Batch));
-
-	batch->vertexCapacity = INITIAL_QUAD_CAPACITY * 4;
-	batch->vertices = Wellspring_malloc(sizeof(Wellspring_Vertex) * batch->vertexCapacity);
-	batch->vertexCount = 0;
+static void WELLSPRINGCALL Wellspring_INTERNAL_DefaultParallelFor(
+	void *userdata,
+	uint32_t count,
+	Wellspring_ParallelTask task,
+	void *taskData
+) {
+	(void) userdata;
 
-	return (Wellspring_TextBatch*) batch;
+	Wellspring_INTERNAL_RunParallel(count, PARALLEL_MIN_ITEMS_PER_THREAD, task, taskData);
 }
 
-void Wellspring_StartTextBatch(
-	Wellspring_TextBatch *textBatch
-) {
-	Batch *batch = (Batch*) textBatch;
-	batch->vertexCount = 0;
-	batch->chunkCount = 0;
-}
-
-static float Wellspring_INTERNAL_GetVerticalAlignOffset(
-	Font *font,
-	Wellspring_VerticalAlignment verticalAlignment,
-	float scale
-) {
-	if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_BASELINE)
-	{
-		return 0;
-	}
-	else if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_TOP)
-	{
-		return scale * font->ascender;
-	}
-	else if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_MIDDLE)
-	{
-		return scale * (font->ascender + font->descender) / 2.0f;
-	}
-	else /* BOTTOM */
-	{
-		return scale * font->descender;
-	}
-}
+/* Fonts */
 
 static inline uint32_t IsWhitespace(uint32_t codepoint)
 {
@@ -546,353 +1050,4385 @@ static inline uint32_t IsNewline(uint32_t codepoint)
 	return codepoint == '\n';
 }
 
-static void GetPackedQuad(PackedChar *charData, float scale, int packerWidth, int packerHeight, int charIndex, float *xPos, float *yPos, Quad *q)
+typedef struct GlyphIngest
 {
-	float texelWidth = 1.0f / packerWidth, texelHeight = 1.0f / packerHeight;
-	PackedChar *b = charData + charIndex;
-
-	float pl, pb, pr, pt;
-	float il, ib, ir, it;
-
-	pl = *xPos + b->planeLeft * scale;
-	pb = *yPos + b->planeBottom * scale;
-	pr = *xPos + b->planeRight * scale;
-	pt = *yPos + b->planeTop * scale;
-
-	il = b->atlasLeft * texelWidth;
-	ib = b->atlasBottom * texelHeight;
-	ir = b->atlasRight * texelWidth;
-	it = b->atlasTop * texelHeight;
-
-	q->x0 = pl;
-	q->y0 = pt;
-	q->x1 = pr;
-	q->y1 = pb;
-
-	q->s0 = il;
-	q->t0 = it;
-	q->s1 = ir;
-	q->t1 = ib;
+	const stbtt_fontinfo *fontInfo; /* NULL when kerning doesn't come from the font file */
+	json_object_t **glyphObjects;
+	uint16_t *pages; /* per glyph object, the atlas page it came from */
+	uint32_t *codepoints;
+	uint16_t *fontGlyphs; /* per glyph table index, the font file's glyph */
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRects;
+	SDL_AtomicInt outOfRange; /* set if any bounds don't fit the 16-bit tables */
+} GlyphIngest;
+
+static inline uint16_t Wellspring_INTERNAL_ToAtlasUnits(double texels)
+{
+	double units = Wellspring_round(texels * ATLAS_UNITS_PER_TEXEL);
+	return (uint16_t) Wellspring_clamp(units, 0, UINT16_MAX);
+}
 
-	*xPos += b->xAdvance * scale;
+static inline int16_t Wellspring_INTERNAL_ToPlaneUnits(double ems)
+{
+	double units = Wellspring_round(ems * PLANE_UNITS_PER_EM);
+	return (int16_t) Wellspring_clamp(units, INT16_MIN, INT16_MAX);
 }
 
-static uint8_t Wellspring_Internal_TextBounds(
-	Font* font,
-	int pixelSize,
-	Wellspring_HorizontalAlignment horizontalAlignment,
-	Wellspring_VerticalAlignment verticalAlignment,
-	const uint8_t* strBytes,
-	uint32_t strLengthInBytes,
-	Wellspring_Rectangle *pRectangle
-) {
-	uint32_t decodeState = 0;
-	uint32_t codepoint;
-	int32_t glyphIndex;
-	int32_t previousGlyphIndex = -1;
-	int32_t rangeIndex;
-	PackedChar* rangeData;
-	Quad charQuad;
-	uint32_t i, j;
-	float x = 0, y = 0;
-	float minX = x;
-	float minY = y;
-	float maxX = x;
-	float maxY = y;
-	float startX = x;
-	float advance = 0;
-	float sizeFactor = pixelSize / font->pixelsPerEm;
+static inline uint8_t Wellspring_INTERNAL_FitsAtlasUnits(double texels)
+{
+	double units = Wellspring_round(texels * ATLAS_UNITS_PER_TEXEL);
+	return units >= 0 && units <= UINT16_MAX;
+}
 
-	y -= Wellspring_INTERNAL_GetVerticalAlignOffset(font, verticalAlignment, sizeFactor * font->scale);
+static inline uint8_t Wellspring_INTERNAL_FitsPlaneUnits(double ems)
+{
+	double units = Wellspring_round(ems * PLANE_UNITS_PER_EM);
+	return units >= INT16_MIN && units <= INT16_MAX;
+}
 
-	for (i = 0; i < strLengthInBytes; i += 1)
+/* Converts glyph JSON objects into glyph table entries. Each index is independent. */
+static void WELLSPRINGCALL Wellspring_INTERNAL_IngestGlyphsTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	GlyphIngest *ingest = (GlyphIngest*) taskData;
+	json_object_t *currentGlyphObject;
+	json_object_t *boundsObject, *planeObject;
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRect;
+	double atlasLeft, atlasRight, atlasTop, atlasBottom;
+	double planeLeft, planeRight, planeTop, planeBottom;
+	uint32_t i;
+
+	for (i = begin; i < end; i += 1)
 	{
-		if (decode(&decodeState, &codepoint, strBytes[i]))
-		{
-			if (decodeState == UTF8_REJECT)
-			{
-				/* Something went very wrong */
-				return 0;
-			}
-
-			continue;
-		}
-
-		if (IsNewline(codepoint))
+		currentGlyphObject = ingest->glyphObjects[i];
+		metrics = &ingest->metrics[i];
+		atlasRect = &ingest->atlasRects[i];
+
+		ingest->codepoints[i] = json_object_get_uint(currentGlyphObject, "unicode");
+
+		atlasRect->left = 0;
+		atlasRect->right = 0;
+		atlasRect->top = 0;
+		atlasRect->bottom = 0;
+		metrics->planeLeft = 0;
+		metrics->planeRight = 0;
+		metrics->planeTop = 0;
+		metrics->planeBottom = 0;
+
+		metrics->xAdvance = json_object_get_double(currentGlyphObject, "advance");
+		metrics->flags = IsWhitespace(ingest->codepoints[i]) ? GLYPH_FLAG_WHITESPACE : 0;
+		metrics->page = ingest->pages[i];
+
+		if (ingest->fontInfo != NULL)
 		{
-			y += sizeFactor * font->lineHeight * font->scale;
-			maxY += sizeFactor * font->lineHeight * font->scale;
-			x = 0;
-			previousGlyphIndex = -1;
-			continue;
+			ingest->fontGlyphs[i] = (uint16_t) stbtt_FindGlyphIndex(ingest->fontInfo, ingest->codepoints[i]);
 		}
 
-		rangeData = NULL;
-
-		Packer *packer = &font->packer;
-
-		/* Find the packed char data */
-		for (j = 0; j < packer->rangeCount; j += 1)
+		if (json_object_has_key(currentGlyphObject, "atlasBounds"))
 		{
+			boundsObject = json_object_get_object(currentGlyphObject, "atlasBounds");
+			atlasLeft = json_object_get_double(boundsObject, "left");
+			atlasRight = json_object_get_double(boundsObject, "right");
+			atlasTop = json_object_get_double(boundsObject, "top");
+			atlasBottom = json_object_get_double(boundsObject, "bottom");
+
+			planeObject = json_object_get_object(currentGlyphObject, "planeBounds");
+			planeLeft = json_object_get_double(planeObject, "left");
+			planeRight = json_object_get_double(planeObject, "right");
+			planeTop = json_object_get_double(planeObject, "top");
+			planeBottom = json_object_get_double(planeObject, "bottom");
+
+			/* Clamping would draw the glyph stretched, so CreateFont fails instead */
 			if (
-				codepoint >= packer->ranges[j].firstCodepoint &&
-				codepoint < packer->ranges[j].firstCodepoint + packer->ranges[j].charCount
+				!Wellspring_INTERNAL_FitsAtlasUnits(atlasLeft) ||
+				!Wellspring_INTERNAL_FitsAtlasUnits(atlasRight) ||
+				!Wellspring_INTERNAL_FitsAtlasUnits(atlasTop) ||
+				!Wellspring_INTERNAL_FitsAtlasUnits(atlasBottom) ||
+				!Wellspring_INTERNAL_FitsPlaneUnits(planeLeft) ||
+				!Wellspring_INTERNAL_FitsPlaneUnits(planeRight) ||
+				!Wellspring_INTERNAL_FitsPlaneUnits(planeTop) ||
+				!Wellspring_INTERNAL_FitsPlaneUnits(planeBottom)
 			) {
-				rangeData = packer->ranges[j].data;
-				rangeIndex = codepoint - packer->ranges[j].firstCodepoint;
-				break;
+				SDL_SetAtomicInt(&ingest->outOfRange, 1);
 			}
-		}
 
-		if (rangeData == NULL)
-		{
-			// Requested char wasn't packed!
-			// Just treat this like whitespace for now.
-			x += sizeFactor * font->scale * 0.2;
-			maxX += sizeFactor * font->scale * 0.2;
-			previousGlyphIndex = -1;
-			continue;
-		}
+			atlasRect->left = Wellspring_INTERNAL_ToAtlasUnits(atlasLeft);
+			atlasRect->right = Wellspring_INTERNAL_ToAtlasUnits(atlasRight);
+			atlasRect->top = Wellspring_INTERNAL_ToAtlasUnits(atlasTop);
+			atlasRect->bottom = Wellspring_INTERNAL_ToAtlasUnits(atlasBottom);
 
-		if (IsWhitespace(codepoint))
-		{
-			PackedChar *packedChar = rangeData + rangeIndex;
-			x += sizeFactor * font->scale * packedChar->xAdvance;
-			maxX += sizeFactor * font->scale * packedChar->xAdvance;
-			previousGlyphIndex = -1;
-			continue;
+			metrics->planeLeft = Wellspring_INTERNAL_ToPlaneUnits(planeLeft);
+			metrics->planeRight = Wellspring_INTERNAL_ToPlaneUnits(planeRight);
+			metrics->planeTop = Wellspring_INTERNAL_ToPlaneUnits(planeTop);
+			metrics->planeBottom = Wellspring_INTERNAL_ToPlaneUnits(planeBottom);
 		}
+	}
+}
 
-		glyphIndex = stbtt_FindGlyphIndex(&font->fontInfo, codepoint);
+/* Kerning */
 
-		if (previousGlyphIndex != -1)
+static inline KerningPair* Wellspring_INTERNAL_FindKerningPair(const KerningTable *table, uint32_t first, uint32_t second)
+{
+	uint32_t mask = table->capacity - 1;
+	uint32_t i = (uint32_t) (((((uint64_t) first << 32) | second) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+	while (
+		table->pairs[i].first != KERNING_EMPTY_GLYPH &&
+		(table->pairs[i].first != first || table->pairs[i].second != second)
+	) {
+		i = (i + 1) & mask;
+	}
+
+	return &table->pairs[i];
+}
+
+/* A pair that is already in the table keeps its advance */
+static void Wellspring_INTERNAL_AddKerningPair(KerningTable *table, uint32_t first, uint32_t second, float advance)
+{
+	KerningTable grown;
+	KerningPair *pair;
+	uint32_t i;
+
+	/* Fonts keep their tables as built, so they are packed tighter than other tables */
+	if ((uint64_t) (table->count + 1) * 4 > (uint64_t) table->capacity * 3)
+	{
+		grown.capacity = table->capacity == 0 ? KERNING_INITIAL_CAPACITY : table->capacity * 2;
+		grown.count = table->count;
+		grown.pairs = Wellspring_malloc(sizeof(KerningPair) * grown.capacity);
+		Wellspring_memset(grown.pairs, 0xFF, sizeof(KerningPair) * grown.capacity);
+
+		for (i = 0; i < table->capacity; i += 1)
 		{
-			x += sizeFactor * font->kerningScale * font->scale * stbtt_GetGlyphKernAdvance(&font->fontInfo, previousGlyphIndex, glyphIndex);
+			if (table->pairs[i].first != KERNING_EMPTY_GLYPH)
+			{
+				*Wellspring_INTERNAL_FindKerningPair(&grown, table->pairs[i].first, table->pairs[i].second) = table->pairs[i];
+			}
 		}
 
-		GetPackedQuad(
-			rangeData,
-			sizeFactor * font->scale,
-			packer->width,
-			packer->height,
-			rangeIndex,
-			&x,
-			&y,
-			&charQuad
-		);
-
-		if (charQuad.x0 < minX) { minX = charQuad.x0; }
-		if (charQuad.x1 > maxX) { maxX = charQuad.x1; }
-		if (charQuad.y0 < minY) { minY = charQuad.y0; }
-		if (charQuad.y1 > maxY) { maxY = charQuad.y1; }
+		Wellspring_free(table->pairs);
+		*table = grown;
+	}
 
-		previousGlyphIndex = glyphIndex;
+	pair = Wellspring_INTERNAL_FindKerningPair(table, first, second);
+	if (pair->first == KERNING_EMPTY_GLYPH)
+	{
+		pair->first = first;
+		pair->second = second;
+		pair->advance = advance;
+		table->count += 1;
 	}
+}
 
-	advance = x - startX;
+#define GLYPH_SLOT_NONE UINT32_MAX
 
-	if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_RIGHT)
+/* Kerning read out of the font file, for the glyphs the atlas has */
+typedef struct FontKerning
+{
+	const stbtt_fontinfo *fontInfo;
+	uint32_t *firstSlots; /* per font glyph, the first glyph table index showing it */
+	uint32_t *nextSlots; /* per glyph table index, the next one showing the same font glyph */
+	uint16_t *glyphs; /* font glyphs the atlas has, ascending */
+	uint32_t glyphCount;
+	KerningTable glyphPairs; /* keyed by font glyph, in font units */
+	SDL_SpinLock glyphPairsLock; /* held while a worker merges its pairs */
+} FontKerning;
+
+static inline uint8_t Wellspring_INTERNAL_InAtlas(const FontKerning *kerning, uint32_t glyph)
+{
+	return glyph < (uint32_t) kerning->fontInfo->numGlyphs && kerning->firstSlots[glyph] != GLYPH_SLOT_NONE;
+}
+
+static void Wellspring_INTERNAL_ReadKernTable(FontKerning *kerning)
+{
+	stbtt_kerningentry *entries;
+	int length = stbtt_GetKerningTableLength(kerning->fontInfo);
+	int i;
+
+	if (length == 0)
 	{
-		minX -= advance;
-		maxX -= advance;
+		return;
 	}
-	else if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_CENTER)
+
+	entries = Wellspring_malloc(sizeof(stbtt_kerningentry) * length);
+	length = stbtt_GetKerningTable(kerning->fontInfo, entries, length);
+
+	for (i = 0; i < length; i += 1)
 	{
-		minX -= advance * 0.5f;
-		maxX -= advance * 0.5f;
+		if (
+			entries[i].advance != 0 &&
+			Wellspring_INTERNAL_InAtlas(kerning, entries[i].glyph1) &&
+			Wellspring_INTERNAL_InAtlas(kerning, entries[i].glyph2)
+		) {
+			Wellspring_INTERNAL_AddKerningPair(
+				&kerning->glyphPairs,
+				entries[i].glyph1,
+				entries[i].glyph2,
+				(float) entries[i].advance
+			);
+		}
 	}
 
-	pRectangle->x = minX;
-	pRectangle->y = minY;
-	pRectangle->w = maxX - minX;
-	pRectangle->h = maxY - minY;
-
-	return 1;
+	Wellspring_free(entries);
 }
 
-uint8_t Wellspring_TextBounds(
-	Wellspring_Font *font,
-	int pixelSize,
-	Wellspring_HorizontalAlignment horizontalAlignment,
-	Wellspring_VerticalAlignment verticalAlignment,
-	const uint8_t* strBytes,
-	uint32_t strLengthInBytes,
-	Wellspring_Rectangle* pRectangle
-) {
-	return Wellspring_Internal_TextBounds(
-		(Font*) font,
-		pixelSize,
-		horizontalAlignment,
-		verticalAlignment,
-		strBytes,
-		strLengthInBytes,
-		pRectangle
-	);
-}
+/* Walks the GPOS pair adjustments the way stbtt_GetGlyphKernAdvance does,
+ * for the first glyphs in [begin, end) of kerning->glyphs.
+ * The first subtable covering a pair decides it, and any subtable other than
+ * a supported pair list decides every pair starting with the glyphs it covers.
+ * Pairs are gathered per worker and merged at the end. Workers never share a
+ * first glyph, so the merge order doesn't matter.
+ */
+static void WELLSPRINGCALL Wellspring_INTERNAL_ReadPairPositioningTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	FontKerning *kerning = (FontKerning*) taskData;
+	KerningTable glyphPairs = { NULL, 0, 0 };
+	KerningPair *pair;
+	stbtt_uint8 *data = kerning->fontInfo->data + kerning->fontInfo->gpos;
+	stbtt_uint8 *lookupList, *lookupTable, *table, *pairValues, *classRecords;
+	stbtt_uint16 lookupCount, subTableCount, posFormat, pairCount, class1Count, class2Count;
+	stbtt_int32 coverageIndex, firstClass;
+	stbtt_int16 advance;
+	int32_t *secondClasses;
+	uint8_t *decided;
+	uint8_t supported, classesRead;
+	uint32_t lookup, subTable, i, j, first, second;
+
+	if (ttUSHORT(data) != 1 || ttUSHORT(data + 2) != 0)
+	{
+		return;
+	}
 
-uint8_t Wellspring_AddChunkToTextBatch(
-	Wellspring_TextBatch *textBatch,
-	Wellspring_Font *font,
-	int pixelSize,
-	Wellspring_HorizontalAlignment horizontalAlignment,
-	Wellspring_VerticalAlignment verticalAlignment,
-	const uint8_t *strBytes,
-	uint32_t strLengthInBytes
-) {
-	Batch *batch = (Batch*) textBatch;
-	Font *currentFont = (Font *)font;
-	Packer *myPacker = &currentFont->packer;
-	uint32_t decodeState = 0;
-	uint32_t codepoint;
-	int32_t glyphIndex;
-	int32_t previousGlyphIndex = -1;
-	int32_t rangeIndex;
-	PackedChar *rangeData;
-	Quad charQuad;
-	uint32_t vertexBufferIndex;
-	Wellspring_Rectangle bounds;
-	uint32_t i, j;
-	float sizeFactor = pixelSize / currentFont->pixelsPerEm;
-	float x = 0, y = 0;
-	float initialX = 0;
+	lookupList = data + ttUSHORT(data + 8);
+	lookupCount = ttUSHORT(lookupList);
 
-	y -= Wellspring_INTERNAL_GetVerticalAlignOffset(currentFont, verticalAlignment, sizeFactor * currentFont->scale);
+	secondClasses = Wellspring_malloc(sizeof(int32_t) * kerning->glyphCount);
+	decided = Wellspring_malloc(end - begin);
+	Wellspring_memset(decided, 0, end - begin);
 
-	/* FIXME: If we horizontally align, we have to decode and process glyphs twice, very inefficient. */
-	if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_RIGHT)
+	for (lookup = 0; lookup < lookupCount; lookup += 1)
 	{
-		if (!Wellspring_Internal_TextBounds(currentFont, pixelSize, horizontalAlignment, verticalAlignment, strBytes, strLengthInBytes, &bounds))
+		lookupTable = lookupList + ttUSHORT(lookupList + 2 + 2 * lookup);
+
+		if (ttUSHORT(lookupTable) != 2)
 		{
-			/* Something went wrong while calculating bounds. */
-			return 0;
+			continue;
 		}
 
-		initialX = -bounds.w;
+		subTableCount = ttUSHORT(lookupTable + 4);
+
+		for (subTable = 0; subTable < subTableCount; subTable += 1)
+		{
+			table = lookupTable + ttUSHORT(lookupTable + 6 + 2 * subTable);
+			posFormat = ttUSHORT(table);
+			supported = ttUSHORT(table + 4) == 4 && ttUSHORT(table + 6) == 0; /* x advance of the first glyph only */
+			classesRead = 0;
+
+			for (i = begin; i < end; i += 1)
+			{
+				first = kerning->glyphs[i];
+
+				if (decided[i - begin])
+				{
+					continue;
+				}
+
+				coverageIndex = stbtt__GetCoverageIndex(table + ttUSHORT(table + 2), first);
+				if (coverageIndex == -1)
+				{
+					continue;
+				}
+
+				if (posFormat == 1 && supported && coverageIndex < ttUSHORT(table + 8))
+				{
+					/* Pairs missing from the list fall through to later subtables.
+					 * Listed zeroes are kept since they still hide later ones.
+					 */
+					pairValues = table + ttUSHORT(table + 10 + 2 * coverageIndex);
+					pairCount = ttUSHORT(pairValues);
+
+					for (j = 0; j < pairCount; j += 1)
+					{
+						second = ttUSHORT(pairValues + 2 + 4 * j);
+
+						if (Wellspring_INTERNAL_InAtlas(kerning, second))
+						{
+							Wellspring_INTERNAL_AddKerningPair(
+								&glyphPairs,
+								first,
+								second,
+								(float) ttSHORT(pairValues + 4 + 4 * j)
+							);
+						}
+					}
+
+					continue;
+				}
+
+				decided[i - begin] = 1;
+
+				if (posFormat != 2 || !supported)
+				{
+					continue;
+				}
+
+				firstClass = stbtt__GetGlyphClass(table + ttUSHORT(table + 8), first);
+				class1Count = ttUSHORT(table + 12);
+				class2Count = ttUSHORT(table + 14);
+
+				if (firstClass < 0 || firstClass >= class1Count)
+				{
+					continue;
+				}
+
+				/* Every glyph's class, once per subtable */
+				if (!classesRead)
+				{
+					for (j = 0; j < kerning->glyphCount; j += 1)
+					{
+						secondClasses[j] = stbtt__GetGlyphClass(table + ttUSHORT(table + 10), kerning->glyphs[j]);
+					}
+					classesRead = 1;
+				}
+
+				classRecords = table + 16 + 2 * firstClass * class2Count;
+
+				for (j = 0; j < kerning->glyphCount; j += 1)
+				{
+					if (secondClasses[j] < 0 || secondClasses[j] >= class2Count)
+					{
+						continue;
+					}
+
+					advance = ttSHORT(classRecords + 2 * secondClasses[j]);
+
+					if (advance != 0)
+					{
+						Wellspring_INTERNAL_AddKerningPair(
+							&glyphPairs,
+							first,
+							kerning->glyphs[j],
+							(float) advance
+						);
+					}
+				}
+			}
+		}
 	}
-	else if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_CENTER)
+
+	Wellspring_free(secondClasses);
+	Wellspring_free(decided);
+
+	/* Listed zeroes have done their job of hiding later subtables */
+	SDL_LockSpinlock(&kerning->glyphPairsLock);
+	for (i = 0; i < glyphPairs.capacity; i += 1)
 	{
-		if (!Wellspring_Internal_TextBounds(currentFont, pixelSize, horizontalAlignment, verticalAlignment, strBytes, strLengthInBytes, &bounds))
+		pair = &glyphPairs.pairs[i];
+		if (pair->first != KERNING_EMPTY_GLYPH && pair->advance != 0)
 		{
-			/* Something went wrong while calculating bounds. */
-			return 0;
+			Wellspring_INTERNAL_AddKerningPair(&kerning->glyphPairs, pair->first, pair->second, pair->advance);
 		}
+	}
+	SDL_UnlockSpinlock(&kerning->glyphPairsLock);
 
-		initialX = -bounds.w * 0.5f;
+	Wellspring_free(glyphPairs.pairs);
+}
+
+/* Fills the font's kerning table with what stbtt_GetGlyphKernAdvance would
+ * return for every pair of glyphs in the atlas, so the font file can go.
+ */
+static void Wellspring_INTERNAL_LoadFontKerning(
+	const stbtt_fontinfo *fontInfo,
+	const uint16_t *fontGlyphs,
+	GlyphMetrics *metrics,
+	uint32_t glyphCount,
+	KerningTable *table
+) {
+	FontKerning kerning;
+	KerningPair *pair;
+	uint32_t fontGlyphCount = (uint32_t) fontInfo->numGlyphs;
+	uint32_t glyph, slot, firstSlot, secondSlot, i;
+
+	if (!fontInfo->gpos && !fontInfo->kern)
+	{
+		return;
 	}
 
-	x = initialX;
+	kerning.fontInfo = fontInfo;
+	kerning.firstSlots = Wellspring_malloc(sizeof(uint32_t) * fontGlyphCount);
+	kerning.nextSlots = Wellspring_malloc(sizeof(uint32_t) * glyphCount);
+	kerning.glyphs = Wellspring_malloc(sizeof(uint16_t) * glyphCount);
+	kerning.glyphCount = 0;
+	kerning.glyphPairs.pairs = NULL;
+	kerning.glyphPairs.count = 0;
+	kerning.glyphPairs.capacity = 0;
+	kerning.glyphPairsLock = 0;
+
+	Wellspring_memset(kerning.firstSlots, 0xFF, sizeof(uint32_t) * fontGlyphCount);
 
-	for (i = 0; i < strLengthInBytes; i += 1)
+	/* Codepoints without a glyph share glyph 0, so a font glyph can have several slots */
+	for (slot = glyphCount; slot > 0; slot -= 1)
 	{
-		if (decode(&decodeState, &codepoint, strBytes[i]))
-		{
-			if (decodeState == UTF8_REJECT)
-			{
-				/* Something went wrong while decoding UTF-8. */
-				return 0;
-			}
+		glyph = fontGlyphs[slot - 1];
+		kerning.nextSlots[slot - 1] = GLYPH_SLOT_NONE;
 
-			continue;
+		if (glyph < fontGlyphCount)
+		{
+			kerning.nextSlots[slot - 1] = kerning.firstSlots[glyph];
+			kerning.firstSlots[glyph] = slot - 1;
 		}
+	}
 
-		if (IsNewline(codepoint))
+	for (glyph = 0; glyph < fontGlyphCount; glyph += 1)
+	{
+		if (kerning.firstSlots[glyph] != GLYPH_SLOT_NONE)
 		{
-			y += sizeFactor * currentFont->lineHeight * currentFont->scale;
-			x = initialX;
-			previousGlyphIndex = -1;
-			continue;
+			kerning.glyphs[kerning.glyphCount] = (uint16_t) glyph;
+			kerning.glyphCount += 1;
 		}
+	}
 
-		rangeData = NULL;
+	/* stb_truetype ignores the kern table when there is a GPOS table */
+	if (fontInfo->gpos)
+	{
+		/* Class pairs cost every first glyph a pass over every glyph, so they're split by first glyph.
+		 * Each worker reads the glyph classes once per subtable, so the ranges are kept large.
+		 */
+		Wellspring_INTERNAL_RunParallel(kerning.glyphCount, KERNING_MIN_GLYPHS_PER_THREAD, Wellspring_INTERNAL_ReadPairPositioningTask, &kerning);
+	}
+	else
+	{
+		Wellspring_INTERNAL_ReadKernTable(&kerning);
+	}
 
-		/* Find the packed char data */
-		for (j = 0; j < myPacker->rangeCount; j += 1)
-		{
-			if (
-				codepoint >= myPacker->ranges[j].firstCodepoint &&
-				codepoint < myPacker->ranges[j].firstCodepoint + myPacker->ranges[j].charCount
-			) {
-				rangeData = myPacker->ranges[j].data;
-				rangeIndex = codepoint - myPacker->ranges[j].firstCodepoint;
-				break;
-			}
-		}
+	for (i = 0; i < kerning.glyphPairs.capacity; i += 1)
+	{
+		pair = &kerning.glyphPairs.pairs[i];
 
-		if (rangeData == NULL)
+		if (pair->first == KERNING_EMPTY_GLYPH || pair->advance == 0)
 		{
-			// Requested char wasn't packed!
-			// Just treat this like whitespace for now.
-			x += sizeFactor * currentFont->scale * 0.2;
-			previousGlyphIndex = -1;
 			continue;
 		}
 
-		if (IsWhitespace(codepoint))
+		for (firstSlot = kerning.firstSlots[pair->first]; firstSlot != GLYPH_SLOT_NONE; firstSlot = kerning.nextSlots[firstSlot])
 		{
-			PackedChar *packedChar = rangeData + rangeIndex;
-			x += sizeFactor * currentFont->scale * packedChar->xAdvance;
-			previousGlyphIndex = -1;
-			continue;
+			metrics[firstSlot].flags |= GLYPH_FLAG_KERNING;
+
+			for (secondSlot = kerning.firstSlots[pair->second]; secondSlot != GLYPH_SLOT_NONE; secondSlot = kerning.nextSlots[secondSlot])
+			{
+				Wellspring_INTERNAL_AddKerningPair(table, firstSlot, secondSlot, pair->advance);
+			}
 		}
+	}
 
-		glyphIndex = stbtt_FindGlyphIndex(&currentFont->fontInfo, codepoint);
+	Wellspring_free(kerning.firstSlots);
+	Wellspring_free(kerning.nextSlots);
+	Wellspring_free(kerning.glyphs);
+	Wellspring_free(kerning.glyphPairs.pairs);
+}
 
-		if (previousGlyphIndex != -1)
-		{
-			x += sizeFactor * currentFont->kerningScale * currentFont->scale * stbtt_GetGlyphKernAdvance(&currentFont->fontInfo, previousGlyphIndex, glyphIndex);
-		}
+/* The glyph tables are sorted by codepoint when the font is created */
+static uint32_t Wellspring_INTERNAL_FindGlyphSlot(const uint32_t *codepoints, uint32_t glyphCount, uint32_t codepoint)
+{
+	uint32_t low = 0;
+	uint32_t high = glyphCount;
+	uint32_t middle;
 
-		GetPackedQuad(
-			rangeData,
-			sizeFactor * currentFont->scale,
-			myPacker->width,
-			myPacker->height,
-			rangeIndex,
-			&x,
-			&y,
-			&charQuad
-		);
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
 
-		if (batch->vertexCount >= batch->vertexCapacity)
+		if (codepoints[middle] < codepoint)
+		{
+			low = middle + 1;
+		}
+		else
 		{
-			batch->vertexCapacity *= 2;
-			batch->vertices = Wellspring_realloc(batch->vertices, sizeof(Wellspring_Vertex) * batch->vertexCapacity);
+			high = middle;
 		}
+	}
 
-		vertexBufferIndex = batch->vertexCount;
+	return (low < glyphCount && codepoints[low] == codepoint) ? low : GLYPH_SLOT_NONE;
+}
 
-		batch->vertices[vertexBufferIndex].x = charQuad.x0;
-		batch->vertices[vertexBufferIndex].y = charQuad.y0;
-		batch->vertices[vertexBufferIndex].u = charQuad.s0;
-		batch->vertices[vertexBufferIndex].v = charQuad.t0;
-		batch->vertices[vertexBufferIndex].chunkIndex = batch->chunkCount;
+/* Atlas kerning pairs are given by codepoint, in ems */
+static void Wellspring_INTERNAL_LoadAtlasKerning(
+	const json_array_t *kerningArray,
+	const uint32_t *codepoints,
+	GlyphMetrics *metrics,
+	uint32_t glyphCount,
+	KerningTable *table
+) {
+	json_array_element_t *element;
+	json_object_t *pairObject;
+	uint32_t firstSlot, secondSlot;
+	float advance;
 
-		batch->vertices[vertexBufferIndex + 1].x = charQuad.x0;
-		batch->vertices[vertexBufferIndex + 1].y = charQuad.y1;
-		batch->vertices[vertexBufferIndex + 1].u = charQuad.s0;
-		batch->vertices[vertexBufferIndex + 1].v = charQuad.t1;
-		batch->vertices[vertexBufferIndex + 1].chunkIndex = batch->chunkCount;
+	for (element = kerningArray->start; element != NULL; element = element->next)
+	{
+		pairObject = json_value_as_object(element->value);
 
-		batch->vertices[vertexBufferIndex + 2].x = charQuad.x1;
-		batch->vertices[vertexBufferIndex + 2].y = charQuad.y0;
-		batch->vertices[vertexBufferIndex + 2].u = charQuad.s1;
-		batch->vertices[vertexBufferIndex + 2].v = charQuad.t0;
-		batch->vertices[vertexBufferIndex + 2].chunkIndex = batch->chunkCount;
+		if (pairObject == NULL)
+		{
+			continue;
+		}
 
-		batch->vertices[vertexBufferIndex + 3].x = charQuad.x1;
-		batch->vertices[vertexBufferIndex + 3].y = charQuad.y1;
-		batch->vertices[vertexBufferIndex + 3].u = charQuad.s1;
-		batch->vertices[vertexBufferIndex + 3].v = charQuad.t1;
-		batch->vertices[vertexBufferIndex + 3].chunkIndex = batch->chunkCount;
+		firstSlot = Wellspring_INTERNAL_FindGlyphSlot(codepoints, glyphCount, json_object_get_uint(pairObject, "unicode1"));
+		secondSlot = Wellspring_INTERNAL_FindGlyphSlot(codepoints, glyphCount, json_object_get_uint(pairObject, "unicode2"));
+		advance = (float) json_object_get_double(pairObject, "advance");
 
-		batch->vertexCount += 4;
+		if (firstSlot == GLYPH_SLOT_NONE || secondSlot == GLYPH_SLOT_NONE || advance == 0)
+		{
+			continue;
+		}
+
+		metrics[firstSlot].flags |= GLYPH_FLAG_KERNING;
+		Wellspring_INTERNAL_AddKerningPair(table, firstSlot, secondSlot, advance);
+	}
+}
+
+/* Everything a new font starts with, however its glyphs were loaded */
+static void Wellspring_INTERNAL_InitFontState(Font *font)
+{
+	font->atlasID = (uint32_t) SDL_AddAtomicInt(&nextAtlasID, 1);
+
+	font->dynamic = NULL;
+
+	SDL_SetAtomicInt(&font->layoutCalls, 0);
+	font->missingLock = 0;
+	font->missingCodepoints = NULL;
+	font->missingCodepointCount = 0;
+	font->missingCodepointCapacity = 0;
+	font->missingGlyphs = 0;
+}
+
+static void Wellspring_INTERNAL_SetPageSize(AtlasPage *page, uint32_t width, uint32_t height)
+{
+	page->width = width;
+	page->height = height;
+	page->atlasScaleX = 1.0f / (int) width / ATLAS_UNITS_PER_TEXEL;
+	page->atlasScaleY = 1.0f / (int) height / ATLAS_UNITS_PER_TEXEL;
+}
+
+/* Each run of consecutive codepoints becomes a range. All ranges share one allocation.
+ * codepoints are indexed like the packer's glyph tables and must be sorted.
+ */
+static void Wellspring_INTERNAL_BuildRanges(Packer *packer, const uint32_t *codepoints)
+{
+	uint32_t glyphIndex, rangeIndex, rangeStart;
+
+	packer->rangeCount = 1;
+	for (glyphIndex = 1; glyphIndex < packer->glyphCount; glyphIndex += 1)
+	{
+		if (codepoints[glyphIndex] != codepoints[glyphIndex - 1] + 1)
+		{
+			packer->rangeCount += 1;
+		}
+	}
+
+	packer->ranges = Wellspring_malloc(sizeof(CharRange) * packer->rangeCount);
+
+	rangeStart = 0;
+	rangeIndex = 0;
+	for (glyphIndex = 1; glyphIndex <= packer->glyphCount; glyphIndex += 1)
+	{
+		if (glyphIndex == packer->glyphCount || codepoints[glyphIndex] != codepoints[glyphIndex - 1] + 1)
+		{
+			packer->ranges[rangeIndex].firstCodepoint = codepoints[rangeStart];
+			packer->ranges[rangeIndex].charCount = glyphIndex - rangeStart;
+			packer->ranges[rangeIndex].data = packer->metrics + rangeStart;
+			rangeIndex += 1;
+			rangeStart = glyphIndex;
+		}
+	}
+}
+
+#define Wellspring_INTERNAL_AlignArena(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+/* Gives a fully loaded font its permanent storage. With font arenas on, the
+ * font, its glyph tables, its pages and its kerning table are carved out of a
+ * single block.
+ */
+static Font* Wellspring_INTERNAL_StoreFont(const Font *staged)
+{
+	size_t glyphTablesOffset = Wellspring_INTERNAL_AlignArena(sizeof(Font));
+	size_t glyphTablesSize = (sizeof(GlyphMetrics) + sizeof(AtlasRect)) * staged->packer.glyphCount;
+	size_t rangesOffset = Wellspring_INTERNAL_AlignArena(glyphTablesOffset + glyphTablesSize);
+	size_t pagesOffset = Wellspring_INTERNAL_AlignArena(rangesOffset + sizeof(CharRange) * staged->packer.rangeCount);
+	size_t kerningOffset = Wellspring_INTERNAL_AlignArena(pagesOffset + sizeof(AtlasPage) * staged->packer.pageCount);
+	size_t arenaSize = kerningOffset + sizeof(KerningPair) * staged->kerning.capacity;
+	uint8_t *arena;
+	Font *font;
+	uint32_t i;
+
+	if (fontArenas)
+	{
+		arena = Wellspring_malloc(arenaSize);
+		font = (Font*) arena;
+		*font = *staged;
+		font->arena = 1;
+		font->packer.metrics = (GlyphMetrics*) (arena + glyphTablesOffset);
+		font->packer.atlasRects = (AtlasRect*) (font->packer.metrics + font->packer.glyphCount);
+		font->packer.ranges = (CharRange*) (arena + rangesOffset);
+		font->packer.pages = (AtlasPage*) (arena + pagesOffset);
+		font->kerning.pairs = staged->kerning.capacity == 0 ? NULL : (KerningPair*) (arena + kerningOffset);
+
+		Wellspring_memcpy(font->packer.metrics, staged->packer.metrics, glyphTablesSize);
+		Wellspring_memcpy(font->packer.ranges, staged->packer.ranges, sizeof(CharRange) * staged->packer.rangeCount);
+		Wellspring_memcpy(font->packer.pages, staged->packer.pages, sizeof(AtlasPage) * staged->packer.pageCount);
+
+		for (i = 0; i < font->packer.rangeCount; i += 1)
+		{
+			font->packer.ranges[i].data = font->packer.metrics + (staged->packer.ranges[i].data - staged->packer.metrics);
+		}
+
+		if (staged->kerning.capacity > 0)
+		{
+			Wellspring_memcpy(font->kerning.pairs, staged->kerning.pairs, sizeof(KerningPair) * staged->kerning.capacity);
+		}
+
+		Wellspring_free(staged->packer.metrics);
+		Wellspring_free(staged->packer.ranges);
+		Wellspring_free(staged->packer.pages);
+		Wellspring_free(staged->kerning.pairs);
+	}
+	else
+	{
+		font = Wellspring_malloc(sizeof(Font));
+		*font = *staged;
+		font->arena = 0;
+	}
+
+	return font;
+}
+
+/* The parts of one atlas JSON that a font is built from */
+typedef struct AtlasJson
+{
+	json_value_t *root;
+	json_object_t *atlas;
+	json_object_t *metrics;
+	json_array_t *glyphs;
+	json_array_t *kerning; /* NULL when the atlas has no kerning */
+} AtlasJson;
+
+static uint8_t Wellspring_INTERNAL_ParseAtlasJson(
+	const uint8_t *atlasJsonBytes,
+	uint32_t atlasJsonBytesLength,
+	AtlasJson *atlasJson
+) {
+	json_value_t *jsonRoot = json_parse(atlasJsonBytes, atlasJsonBytesLength);
+	json_object_t *jsonObject = jsonRoot != NULL ? jsonRoot->payload : NULL;
+
+	atlasJson->root = jsonRoot;
+	atlasJson->kerning = NULL;
+
+	if (jsonObject == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas JSON is invalid! Bailing!");
+		return 0;
+	}
+
+	if (SDL_strcmp(jsonObject->start->name->string, "atlas") != 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas JSON is invalid! Bailing!");
+		return 0;
+	}
+
+	atlasJson->atlas = json_object_get_object(jsonObject, "atlas");
+	if (atlasJson->atlas == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
+		return 0;
+	}
+
+	atlasJson->metrics = json_object_get_object(jsonObject, "metrics");
+	if (atlasJson->metrics == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
+		return 0;
+	}
+
+	atlasJson->glyphs = json_value_as_array(json_object_get_element_by_name(jsonObject, "glyphs")->value);
+	if (atlasJson->glyphs == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "atlas object not found!");
+		return 0;
+	}
+
+	const char* atlasType = json_object_get_string(atlasJson->atlas, "type");
+
+	if (SDL_strcmp(atlasType, "msdf") != 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas is not MSDF! Bailing!");
+		return 0;
+	}
+
+	if (json_object_has_key(jsonObject, "kerning"))
+	{
+		atlasJson->kerning = json_value_as_array(json_object_get_element_by_name(jsonObject, "kerning")->value);
+	}
+
+	return 1;
+}
+
+static void Wellspring_INTERNAL_FreeAtlasJsons(AtlasJson *atlasJsons, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		Wellspring_free(atlasJsons[i].root);
+	}
+
+	Wellspring_free(atlasJsons);
+}
+
+typedef struct GlyphOrder
+{
+	uint32_t codepoint;
+	uint32_t index; /* pages are gathered in order, so lower indices win */
+} GlyphOrder;
+
+static int Wellspring_INTERNAL_CompareGlyphOrder(const void *a, const void *b)
+{
+	const GlyphOrder *orderA = (const GlyphOrder*) a;
+	const GlyphOrder *orderB = (const GlyphOrder*) b;
+
+	if (orderA->codepoint != orderB->codepoint)
+	{
+		return orderA->codepoint < orderB->codepoint ? -1 : 1;
+	}
+
+	return orderA->index < orderB->index ? -1 : orderA->index > orderB->index;
+}
+
+/* Sorts the glyph tables by codepoint, lookups and atlas kerning depend on it.
+ * Codepoints that are listed more than once keep the glyph of the first page.
+ * Returns the new glyph count.
+ */
+static uint8_t Wellspring_INTERNAL_CodepointsSorted(const uint32_t *codepoints, uint32_t glyphCount)
+{
+	uint32_t i;
+
+	for (i = 1; i < glyphCount; i += 1)
+	{
+		if (codepoints[i] <= codepoints[i - 1])
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static uint32_t Wellspring_INTERNAL_MergePageGlyphs(GlyphIngest *ingest, uint32_t glyphCount)
+{
+	GlyphOrder *order = Wellspring_malloc(sizeof(GlyphOrder) * glyphCount);
+	uint32_t *codepoints;
+	uint16_t *fontGlyphs;
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRects;
+	uint32_t mergedCount = 0;
+	uint32_t i, index;
+
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		order[i].codepoint = ingest->codepoints[i];
+		order[i].index = i;
+	}
+
+	Wellspring_sort(order, glyphCount, sizeof(GlyphOrder), Wellspring_INTERNAL_CompareGlyphOrder);
+
+	/* Sized exactly, the metrics and atlas rects have to stay back to back */
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		if (i == 0 || order[i].codepoint != order[i - 1].codepoint)
+		{
+			mergedCount += 1;
+		}
+	}
+
+	codepoints = Wellspring_malloc(sizeof(uint32_t) * mergedCount);
+	fontGlyphs = ingest->fontGlyphs != NULL ? Wellspring_malloc(sizeof(uint16_t) * mergedCount) : NULL;
+	metrics = Wellspring_malloc((sizeof(GlyphMetrics) + sizeof(AtlasRect)) * mergedCount);
+	atlasRects = (AtlasRect*) (metrics + mergedCount);
+
+	mergedCount = 0;
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		if (i > 0 && order[i].codepoint == order[i - 1].codepoint)
+		{
+			continue;
+		}
+
+		index = order[i].index;
+		codepoints[mergedCount] = order[i].codepoint;
+		metrics[mergedCount] = ingest->metrics[index];
+		atlasRects[mergedCount] = ingest->atlasRects[index];
+		if (fontGlyphs != NULL)
+		{
+			fontGlyphs[mergedCount] = ingest->fontGlyphs[index];
+		}
+		mergedCount += 1;
+	}
+
+	Wellspring_free(order);
+	Wellspring_free(ingest->codepoints);
+	Wellspring_free(ingest->fontGlyphs);
+	Wellspring_free(ingest->metrics);
+
+	ingest->codepoints = codepoints;
+	ingest->fontGlyphs = fontGlyphs;
+	ingest->metrics = metrics;
+	ingest->atlasRects = atlasRects;
+
+	return mergedCount;
+}
+
+static Font* Wellspring_INTERNAL_CreateFont(
+	const uint8_t* fontBytes,
+	uint32_t fontBytesLength,
+	const uint8_t *const *atlasJsonBytes,
+	const uint32_t *atlasJsonBytesLengths,
+	uint32_t pageCount,
+	float *pPixelsPerEm,
+	float *pDistanceRange
+) {
+	/* Loaded in place, then moved to its own storage once nothing can fail */
+	Font staged;
+	Font *font = &staged;
+	stbtt_fontinfo fontInfo;
+	const stbtt_fontinfo *kerningFontInfo = NULL;
+	AtlasJson *atlasJsons;
+	uint8_t atlasKerning = 0;
+	uint32_t page;
+
+	if (pageCount == 0 || pageCount > UINT16_MAX)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid atlas page count %u! Bailing!", pageCount);
+		return NULL;
+	}
+
+	atlasJsons = Wellspring_malloc(sizeof(AtlasJson) * pageCount);
+
+	for (page = 0; page < pageCount; page += 1)
+	{
+		Wellspring_INTERNAL_BeginZone(ZONE_PARSE_ATLAS);
+		uint8_t parsed = Wellspring_INTERNAL_ParseAtlasJson(atlasJsonBytes[page], atlasJsonBytesLengths[page], &atlasJsons[page]);
+		Wellspring_INTERNAL_EndZone(ZONE_PARSE_ATLAS);
+
+		if (!parsed)
+		{
+			Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, page + 1);
+			return NULL;
+		}
+
+		/* Glyph metrics are in ems, but the SDFs have to match for one shader to draw every page */
+		if (
+			page > 0 && (
+				json_object_get_double(atlasJsons[page].atlas, "size") != json_object_get_double(atlasJsons[0].atlas, "size") ||
+				json_object_get_double(atlasJsons[page].atlas, "distanceRange") != json_object_get_double(atlasJsons[0].atlas, "distanceRange")
+			)
+		) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas page %u differs in em size or distance range! Bailing!", page);
+			Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, page + 1);
+			return NULL;
+		}
+
+		/* Atlas rects are stored in 16 bits */
+		if (
+			json_object_get_uint(atlasJsons[page].atlas, "width") > ATLAS_MAX_SIZE ||
+			json_object_get_uint(atlasJsons[page].atlas, "height") > ATLAS_MAX_SIZE
+		) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas page %u is larger than %u texels! Bailing!", page, (uint32_t) ATLAS_MAX_SIZE);
+			Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, page + 1);
+			return NULL;
+		}
+
+		atlasKerning |= atlasJsons[page].kerning != NULL;
+	}
+
+	/* Kerning from the atlas wins, otherwise the font file is read for it */
+	if (!atlasKerning && fontBytes != NULL && fontBytesLength > 0)
+	{
+		Wellspring_INTERNAL_BeginZone(ZONE_INIT_FONT);
+		if (!stbtt_InitFont(&fontInfo, fontBytes, 0))
+		{
+			Wellspring_INTERNAL_EndZone(ZONE_INIT_FONT);
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Font file is invalid! Bailing!");
+			Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, pageCount);
+			return NULL;
+		}
+		Wellspring_INTERNAL_EndZone(ZONE_INIT_FONT);
+		kerningFontInfo = &fontInfo;
+	}
+
+	font->pixelsPerEm = json_object_get_double(atlasJsons[0].atlas, "size");
+	font->distanceRange = json_object_get_double(atlasJsons[0].atlas, "distanceRange");
+
+	font->ascender = json_object_get_double(atlasJsons[0].metrics, "ascender");
+	font->descender = json_object_get_double(atlasJsons[0].metrics, "descender");
+	font->lineHeight = json_object_get_double(atlasJsons[0].metrics, "lineHeight");
+
+	font->scale = font->pixelsPerEm * 4 / 3; // converting from "points" (dpi) to pixels
+
+	/* Pack unicode ranges */
+
+	GlyphIngest ingest;
+	uint32_t glyphCount = 0;
+	uint32_t glyphIndex;
+
+	for (page = 0; page < pageCount; page += 1)
+	{
+		glyphCount += (uint32_t) atlasJsons[page].glyphs->length;
+	}
+
+	if (glyphCount == 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", "Atlas has no glyphs!");
+		Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, pageCount);
+		return NULL;
+	}
+
+	Wellspring_INTERNAL_InitFontState(font);
+
+	font->packer.pageCount = pageCount;
+	font->packer.pages = Wellspring_malloc(sizeof(AtlasPage) * pageCount);
+
+	for (page = 0; page < pageCount; page += 1)
+	{
+		Wellspring_INTERNAL_SetPageSize(
+			&font->packer.pages[page],
+			json_object_get_uint(atlasJsons[page].atlas, "width"),
+			json_object_get_uint(atlasJsons[page].atlas, "height")
+		);
+	}
+
+	Wellspring_INTERNAL_BeginZone(ZONE_INGEST_GLYPHS);
+
+	/* The glyph arrays are linked lists, so gather them up front for the workers */
+	ingest.fontInfo = kerningFontInfo;
+	ingest.glyphObjects = Wellspring_malloc(sizeof(json_object_t*) * glyphCount);
+	ingest.pages = Wellspring_malloc(sizeof(uint16_t) * glyphCount);
+	ingest.codepoints = Wellspring_malloc(sizeof(uint32_t) * glyphCount);
+	ingest.fontGlyphs = kerningFontInfo != NULL ? Wellspring_malloc(sizeof(uint16_t) * glyphCount) : NULL;
+	ingest.metrics = Wellspring_malloc((sizeof(GlyphMetrics) + sizeof(AtlasRect)) * glyphCount);
+	ingest.atlasRects = (AtlasRect*) (ingest.metrics + glyphCount);
+
+	glyphIndex = 0;
+	for (page = 0; page < pageCount; page += 1)
+	{
+		json_array_element_t *currentGlyphElement;
+
+		for (currentGlyphElement = atlasJsons[page].glyphs->start; currentGlyphElement != NULL; currentGlyphElement = currentGlyphElement->next)
+		{
+			ingest.glyphObjects[glyphIndex] = json_value_as_object(currentGlyphElement->value);
+			ingest.pages[glyphIndex] = (uint16_t) page;
+			glyphIndex += 1;
+		}
+	}
+
+	SDL_SetAtomicInt(&ingest.outOfRange, 0);
+	Wellspring_INTERNAL_DefaultParallelFor(NULL, glyphCount, Wellspring_INTERNAL_IngestGlyphsTask, &ingest);
+
+	if (SDL_GetAtomicInt(&ingest.outOfRange))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Glyph bounds are beyond the atlas or the plane limits! Bailing!");
+		Wellspring_free(ingest.glyphObjects);
+		Wellspring_free(ingest.pages);
+		Wellspring_free(ingest.codepoints);
+		Wellspring_free(ingest.fontGlyphs);
+		Wellspring_free(ingest.metrics);
+		Wellspring_free(font->packer.pages);
+		Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, pageCount);
+		Wellspring_INTERNAL_EndZone(ZONE_INGEST_GLYPHS);
+		return NULL;
+	}
+
+	/* msdf-atlas-gen writes each page in codepoint order, but other tools may not */
+	if (pageCount > 1 || !Wellspring_INTERNAL_CodepointsSorted(ingest.codepoints, glyphCount))
+	{
+		glyphCount = Wellspring_INTERNAL_MergePageGlyphs(&ingest, glyphCount);
+	}
+
+	font->packer.metrics = ingest.metrics;
+	font->packer.atlasRects = ingest.atlasRects;
+	font->packer.glyphCount = glyphCount;
+	Wellspring_INTERNAL_BuildRanges(&font->packer, ingest.codepoints);
+
+	Wellspring_free(ingest.glyphObjects);
+	Wellspring_free(ingest.pages);
+
+	Wellspring_INTERNAL_EndZone(ZONE_INGEST_GLYPHS);
+	Wellspring_INTERNAL_Plot(PLOT_FONT_GLYPHS, glyphCount);
+
+	Wellspring_INTERNAL_BeginZone(ZONE_LOAD_KERNING);
+	font->kerning.pairs = NULL;
+	font->kerning.count = 0;
+	font->kerning.capacity = 0;
+	font->kerningScale = 1;
+
+	if (atlasKerning)
+	{
+		/* Looked up in the merged tables, so pairs may span pages */
+		for (page = 0; page < pageCount; page += 1)
+		{
+			if (atlasJsons[page].kerning != NULL)
+			{
+				Wellspring_INTERNAL_LoadAtlasKerning(atlasJsons[page].kerning, ingest.codepoints, ingest.metrics, glyphCount, &font->kerning);
+			}
+		}
+	}
+	else if (kerningFontInfo != NULL)
+	{
+		int advanceWidth, bearing;
+		stbtt_GetCodepointHMetrics(kerningFontInfo, font->packer.ranges[0].firstCodepoint, &advanceWidth, &bearing);
+
+		font->kerningScale = font->packer.ranges[0].data[0].xAdvance / advanceWidth;
+
+		Wellspring_INTERNAL_LoadFontKerning(kerningFontInfo, ingest.fontGlyphs, ingest.metrics, glyphCount, &font->kerning);
+	}
+
+	Wellspring_free(ingest.codepoints);
+	Wellspring_free(ingest.fontGlyphs);
+	Wellspring_INTERNAL_EndZone(ZONE_LOAD_KERNING);
+
+	Wellspring_INTERNAL_FreeAtlasJsons(atlasJsons, pageCount);
+
+	*pPixelsPerEm = font->pixelsPerEm;
+	*pDistanceRange = font->distanceRange;
+
+	return Wellspring_INTERNAL_StoreFont(&staged);
+}
+
+Wellspring_Font* Wellspring_CreateFont(
+	const uint8_t* fontBytes,
+	uint32_t fontBytesLength,
+	const uint8_t *atlasJsonBytes,
+	uint32_t atlasJsonBytesLength,
+	float *pPixelsPerEm,
+	float *pDistanceRange
+) {
+	Font *font;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_CREATE_FONT);
+	font = Wellspring_INTERNAL_CreateFont(
+		fontBytes,
+		fontBytesLength,
+		&atlasJsonBytes,
+		&atlasJsonBytesLength,
+		1,
+		pPixelsPerEm,
+		pDistanceRange
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_CREATE_FONT);
+
+	return (Wellspring_Font*) font;
+}
+
+Wellspring_Font* Wellspring_CreateFontFromPages(
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	const uint8_t *const *atlasJsonBytes,
+	const uint32_t *atlasJsonBytesLengths,
+	uint32_t pageCount,
+	float *pPixelsPerEm,
+	float *pDistanceRange
+) {
+	Font *font;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_CREATE_FONT);
+	font = Wellspring_INTERNAL_CreateFont(
+		fontBytes,
+		fontBytesLength,
+		atlasJsonBytes,
+		atlasJsonBytesLengths,
+		pageCount,
+		pPixelsPerEm,
+		pDistanceRange
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_CREATE_FONT);
+
+	return (Wellspring_Font*) font;
+}
+
+void Wellspring_SetFontAtlasID(
+	Wellspring_Font *font,
+	uint32_t atlasID
+) {
+	((Font*) font)->atlasID = atlasID;
+}
+
+uint32_t Wellspring_GetFontAtlasID(
+	Wellspring_Font *font
+) {
+	return ((Font*) font)->atlasID;
+}
+
+/* SDF rasterizing */
+
+/* Same encoding as msdf-atlas-gen: the edge at one half, distanceRange texels from 0 to 1 */
+static void Wellspring_INTERNAL_InitSdfRasterizer(
+	SdfRasterizer *rasterizer,
+	const stbtt_fontinfo *fontInfo,
+	float pixelsPerEm,
+	float distanceRange
+) {
+	rasterizer->fontInfo = fontInfo;
+	rasterizer->sdfScale = stbtt_ScaleForMappingEmToPixels(fontInfo, pixelsPerEm);
+	rasterizer->emScale = stbtt_ScaleForMappingEmToPixels(fontInfo, 1);
+	rasterizer->distanceScale = 255.0f / distanceRange;
+	rasterizer->texelSize = 1.0f / pixelsPerEm;
+	rasterizer->padding = Wellspring_iceil(distanceRange * 0.5f) + 1;
+}
+
+/* Fills in the glyph's metrics, with no flags set.
+ * Returns its SDF, or NULL if the glyph has no outline. Free it with stbtt_FreeSDF.
+ */
+static uint8_t* Wellspring_INTERNAL_RasterizeSDF(
+	const SdfRasterizer *rasterizer,
+	int glyph,
+	GlyphMetrics *metrics,
+	int *pWidth,
+	int *pHeight
+) {
+	uint8_t *sdf;
+	int advanceWidth, bearing, xOffset, yOffset;
+
+	stbtt_GetGlyphHMetrics(rasterizer->fontInfo, glyph, &advanceWidth, &bearing);
+
+	Wellspring_memset(metrics, 0, sizeof(GlyphMetrics));
+	metrics->xAdvance = advanceWidth * rasterizer->emScale;
+
+	sdf = stbtt_GetGlyphSDF(
+		rasterizer->fontInfo,
+		rasterizer->sdfScale,
+		glyph,
+		rasterizer->padding,
+		SDF_ON_EDGE_VALUE,
+		rasterizer->distanceScale,
+		pWidth,
+		pHeight,
+		&xOffset,
+		&yOffset
+	);
+
+	if (sdf != NULL)
+	{
+		metrics->planeLeft = Wellspring_INTERNAL_ToPlaneUnits(xOffset * rasterizer->texelSize);
+		metrics->planeTop = Wellspring_INTERNAL_ToPlaneUnits(yOffset * rasterizer->texelSize);
+		metrics->planeRight = Wellspring_INTERNAL_ToPlaneUnits((xOffset + *pWidth) * rasterizer->texelSize);
+		metrics->planeBottom = Wellspring_INTERNAL_ToPlaneUnits((yOffset + *pHeight) * rasterizer->texelSize);
+	}
+
+	return sdf;
+}
+
+/* Writes the distance to all four channels of an RGBA8 image */
+static void Wellspring_INTERNAL_CopySDF(
+	const uint8_t *sdf,
+	int width,
+	int height,
+	uint8_t *pixels,
+	uint32_t imageWidth,
+	int x,
+	int y
+) {
+	uint8_t *row;
+	int column, line;
+
+	for (line = 0; line < height; line += 1)
+	{
+		row = pixels + ((size_t) (y + line) * imageWidth + x) * 4;
+		for (column = 0; column < width; column += 1)
+		{
+			Wellspring_memset(row + column * 4, sdf[line * width + column], 4);
+		}
+	}
+}
+
+static void Wellspring_INTERNAL_SetAtlasRect(AtlasRect *atlasRect, int x, int y, int width, int height)
+{
+	atlasRect->left = Wellspring_INTERNAL_ToAtlasUnits(x);
+	atlasRect->top = Wellspring_INTERNAL_ToAtlasUnits(y);
+	atlasRect->right = Wellspring_INTERNAL_ToAtlasUnits(x + width);
+	atlasRect->bottom = Wellspring_INTERNAL_ToAtlasUnits(y + height);
+}
+
+/* Atlas building */
+
+#define ATLAS_MIN_GLYPHS_PER_THREAD 16
+
+typedef struct AtlasBuild
+{
+	SdfRasterizer rasterizer;
+	const uint32_t *codepoints;
+	const uint16_t *fontGlyphs;
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRects;
+	uint8_t **sdfs; /* NULL for glyphs that take no space in the image */
+	stbrp_rect *packRects; /* each SDF plus a texel of gap */
+	uint8_t *pixels;
+	uint32_t width;
+} AtlasBuild;
+
+static void WELLSPRINGCALL Wellspring_INTERNAL_RasterizeAtlasTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	AtlasBuild *build = (AtlasBuild*) taskData;
+	GlyphMetrics *metrics;
+	stbrp_rect *packRect;
+	int width, height;
+	uint32_t i;
+
+	for (i = begin; i < end; i += 1)
+	{
+		metrics = &build->metrics[i];
+		packRect = &build->packRects[i];
+
+		build->sdfs[i] = Wellspring_INTERNAL_RasterizeSDF(&build->rasterizer, build->fontGlyphs[i], metrics, &width, &height);
+
+		/* Whitespace is never drawn, even if the font gives it an outline */
+		if (IsWhitespace(build->codepoints[i]))
+		{
+			metrics->flags = GLYPH_FLAG_WHITESPACE;
+			stbtt_FreeSDF(build->sdfs[i], NULL);
+			build->sdfs[i] = NULL;
+		}
+
+		packRect->id = (int) i;
+		packRect->w = build->sdfs[i] != NULL ? width + 1 : 0;
+		packRect->h = build->sdfs[i] != NULL ? height + 1 : 0;
+	}
+}
+
+/* Glyphs were packed into disjoint rects, so the workers never write the same texels */
+static void WELLSPRINGCALL Wellspring_INTERNAL_CopyAtlasTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	AtlasBuild *build = (AtlasBuild*) taskData;
+	stbrp_rect *packRect;
+	uint32_t i;
+
+	for (i = begin; i < end; i += 1)
+	{
+		packRect = &build->packRects[i];
+		Wellspring_memset(&build->atlasRects[i], 0, sizeof(AtlasRect));
+
+		if (build->sdfs[i] != NULL)
+		{
+			Wellspring_INTERNAL_CopySDF(build->sdfs[i], packRect->w - 1, packRect->h - 1, build->pixels, build->width, packRect->x, packRect->y);
+			Wellspring_INTERNAL_SetAtlasRect(&build->atlasRects[i], packRect->x, packRect->y, packRect->w - 1, packRect->h - 1);
+			stbtt_FreeSDF(build->sdfs[i], NULL);
+			build->sdfs[i] = NULL;
+		}
+	}
+}
+
+static int Wellspring_INTERNAL_CompareCodepoints(const void *a, const void *b)
+{
+	uint32_t codepointA = *(const uint32_t*) a;
+	uint32_t codepointB = *(const uint32_t*) b;
+
+	return codepointA < codepointB ? -1 : codepointA > codepointB;
+}
+
+/* The smallest power of two that is at least as wide as every glyph and
+ * leaves some slack for packing if the atlas were square
+ */
+static uint32_t Wellspring_INTERNAL_ChooseAtlasWidth(const stbrp_rect *packRects, uint32_t glyphCount)
+{
+	uint64_t area = 0;
+	uint32_t widest = 1, width = 64, i;
+
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		area += (uint64_t) packRects[i].w * packRects[i].h;
+		widest = Wellspring_max(widest, (uint32_t) packRects[i].w);
+	}
+
+	while ((width < widest || (uint64_t) width * width < area + area / 4) && width * 2 <= ATLAS_MAX_SIZE)
+	{
+		width *= 2;
+	}
+
+	return width;
+}
+
+static Font* Wellspring_INTERNAL_BuildAtlas(
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	float pixelsPerEm,
+	float distanceRange,
+	uint32_t atlasWidth,
+	Wellspring_ParallelFor parallelFor,
+	void *userdata,
+	Wellspring_AtlasImage *pImage
+) {
+	/* Built in place, then moved to its own storage once nothing can fail */
+	Font staged;
+	Font *font = &staged;
+	stbtt_fontinfo fontInfo;
+	AtlasBuild build;
+	stbrp_context packContext;
+	stbrp_node *packNodes;
+	uint32_t *sortedCodepoints;
+	uint16_t *fontGlyphs;
+	uint32_t glyphCount = 0, width, height = 0, i;
+	int glyph, ascent, descent, lineGap;
+
+	if (fontBytes == NULL || fontBytesLength == 0 || codepointCount == 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Building an atlas needs a font file and codepoints!");
+		return NULL;
+	}
+
+	if (!(pixelsPerEm > 0) || !(distanceRange > 0) || atlasWidth > ATLAS_MAX_SIZE)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Atlas size is invalid!");
+		return NULL;
+	}
+
+	if (!stbtt_InitFont(&fontInfo, fontBytes, 0))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Font file is invalid! Bailing!");
+		return NULL;
+	}
+
+	/* Glyph tables are sorted by codepoint, and like msdf-atlas-gen only hold glyphs the font has */
+	sortedCodepoints = Wellspring_malloc(sizeof(uint32_t) * codepointCount);
+	fontGlyphs = Wellspring_malloc(sizeof(uint16_t) * codepointCount);
+	Wellspring_memcpy(sortedCodepoints, codepoints, sizeof(uint32_t) * codepointCount);
+	Wellspring_sort(sortedCodepoints, codepointCount, sizeof(uint32_t), Wellspring_INTERNAL_CompareCodepoints);
+
+	for (i = 0; i < codepointCount; i += 1)
+	{
+		if (glyphCount > 0 && sortedCodepoints[i] == sortedCodepoints[glyphCount - 1])
+		{
+			continue;
+		}
+
+		glyph = stbtt_FindGlyphIndex(&fontInfo, (int) sortedCodepoints[i]);
+		if (glyph != 0)
+		{
+			sortedCodepoints[glyphCount] = sortedCodepoints[i];
+			fontGlyphs[glyphCount] = (uint16_t) glyph;
+			glyphCount += 1;
+		}
+	}
+
+	if (glyphCount == 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Font file has none of the codepoints!");
+		Wellspring_free(sortedCodepoints);
+		Wellspring_free(fontGlyphs);
+		return NULL;
+	}
+
+	Wellspring_INTERNAL_BeginZone(ZONE_RASTERIZE_ATLAS);
+
+	Wellspring_INTERNAL_InitSdfRasterizer(&build.rasterizer, &fontInfo, pixelsPerEm, distanceRange);
+	build.codepoints = sortedCodepoints;
+	build.fontGlyphs = fontGlyphs;
+	build.metrics = Wellspring_malloc((sizeof(GlyphMetrics) + sizeof(AtlasRect)) * glyphCount);
+	build.atlasRects = (AtlasRect*) (build.metrics + glyphCount);
+	build.sdfs = Wellspring_malloc(sizeof(uint8_t*) * glyphCount);
+	build.packRects = Wellspring_malloc(sizeof(stbrp_rect) * glyphCount);
+
+	if (parallelFor != NULL)
+	{
+		parallelFor(userdata, glyphCount, Wellspring_INTERNAL_RasterizeAtlasTask, &build);
+	}
+	else
+	{
+		/* Each glyph is costly, so it's worth a thread much sooner than other work */
+		Wellspring_INTERNAL_RunParallel(glyphCount, ATLAS_MIN_GLYPHS_PER_THREAD, Wellspring_INTERNAL_RasterizeAtlasTask, &build);
+	}
+
+	Wellspring_INTERNAL_EndZone(ZONE_RASTERIZE_ATLAS);
+
+	Wellspring_INTERNAL_BeginZone(ZONE_PACK_ATLAS);
+
+	width = atlasWidth != 0 ? atlasWidth : Wellspring_INTERNAL_ChooseAtlasWidth(build.packRects, glyphCount);
+	packNodes = Wellspring_malloc(sizeof(stbrp_node) * width);
+	stbrp_init_target(&packContext, (int) width, ATLAS_MAX_SIZE, packNodes, (int) width);
+
+	if (!stbrp_pack_rects(&packContext, build.packRects, (int) glyphCount))
+	{
+		Wellspring_INTERNAL_EndZone(ZONE_PACK_ATLAS);
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Glyphs don't fit in the atlas!");
+
+		for (i = 0; i < glyphCount; i += 1)
+		{
+			stbtt_FreeSDF(build.sdfs[i], NULL);
+		}
+
+		Wellspring_free(packNodes);
+		Wellspring_free(build.packRects);
+		Wellspring_free(build.sdfs);
+		Wellspring_free(build.metrics);
+		Wellspring_free(sortedCodepoints);
+		Wellspring_free(fontGlyphs);
+		return NULL;
+	}
+
+	/* The image ends below the lowest glyph, without its gap */
+	for (i = 0; i < glyphCount; i += 1)
+	{
+		if (build.sdfs[i] != NULL)
+		{
+			height = Wellspring_max(height, (uint32_t) (build.packRects[i].y + build.packRects[i].h - 1));
+		}
+	}
+	height = Wellspring_max(height, 1);
+
+	build.width = width;
+	build.pixels = Wellspring_malloc((size_t) width * height * 4);
+	Wellspring_memset(build.pixels, 0, (size_t) width * height * 4);
+
+	if (parallelFor != NULL)
+	{
+		parallelFor(userdata, glyphCount, Wellspring_INTERNAL_CopyAtlasTask, &build);
+	}
+	else
+	{
+		Wellspring_INTERNAL_RunParallel(glyphCount, ATLAS_MIN_GLYPHS_PER_THREAD, Wellspring_INTERNAL_CopyAtlasTask, &build);
+	}
+
+	Wellspring_free(packNodes);
+	Wellspring_free(build.packRects);
+	Wellspring_free(build.sdfs);
+
+	Wellspring_INTERNAL_EndZone(ZONE_PACK_ATLAS);
+	Wellspring_INTERNAL_Plot(PLOT_FONT_GLYPHS, glyphCount);
+
+	/* Vertical metrics follow msdf-atlas-gen's output with the y origin at the top */
+	stbtt_GetFontVMetrics(&fontInfo, &ascent, &descent, &lineGap);
+
+	font->packer.pageCount = 1;
+	font->packer.pages = Wellspring_malloc(sizeof(AtlasPage));
+	Wellspring_INTERNAL_SetPageSize(font->packer.pages, width, height);
+	font->pixelsPerEm = pixelsPerEm;
+	font->distanceRange = distanceRange;
+
+	font->ascender = -ascent * build.rasterizer.emScale;
+	font->descender = -descent * build.rasterizer.emScale;
+	font->lineHeight = (ascent - descent + lineGap) * build.rasterizer.emScale;
+
+	font->scale = font->pixelsPerEm * 4 / 3; // converting from "points" (dpi) to pixels
+
+	Wellspring_INTERNAL_InitFontState(font);
+
+	font->packer.metrics = build.metrics;
+	font->packer.atlasRects = build.atlasRects;
+	font->packer.glyphCount = glyphCount;
+	Wellspring_INTERNAL_BuildRanges(&font->packer, sortedCodepoints);
+
+	font->kerning.pairs = NULL;
+	font->kerning.count = 0;
+	font->kerning.capacity = 0;
+	font->kerningScale = build.rasterizer.emScale;
+	Wellspring_INTERNAL_LoadFontKerning(&fontInfo, fontGlyphs, build.metrics, glyphCount, &font->kerning);
+
+	Wellspring_free(sortedCodepoints);
+	Wellspring_free(fontGlyphs);
+
+	pImage->pixels = build.pixels;
+	pImage->width = width;
+	pImage->height = height;
+
+	return Wellspring_INTERNAL_StoreFont(&staged);
+}
+
+Wellspring_Font* Wellspring_BuildAtlas(
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	const uint32_t *codepoints,
+	uint32_t codepointCount,
+	float pixelsPerEm,
+	float distanceRange,
+	uint32_t atlasWidth,
+	Wellspring_ParallelFor parallelFor,
+	void *userdata,
+	Wellspring_AtlasImage *pImage
+) {
+	Font *font;
+
+	Wellspring_memset(pImage, 0, sizeof(Wellspring_AtlasImage));
+
+	Wellspring_INTERNAL_BeginZone(ZONE_BUILD_ATLAS);
+	font = Wellspring_INTERNAL_BuildAtlas(
+		fontBytes,
+		fontBytesLength,
+		codepoints,
+		codepointCount,
+		pixelsPerEm,
+		distanceRange,
+		atlasWidth,
+		parallelFor,
+		userdata,
+		pImage
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_BUILD_ATLAS);
+
+	return (Wellspring_Font*) font;
+}
+
+/* Dynamic glyphs */
+
+static inline DynamicEntry* Wellspring_INTERNAL_FindDynamicEntry(
+	DynamicEntry *entries,
+	uint32_t capacity,
+	uint32_t codepoint
+) {
+	uint32_t mask = capacity - 1;
+	uint32_t i = (codepoint * 2654435761u) & mask;
+
+	while (entries[i].codepoint != DYNAMIC_EMPTY_CODEPOINT && entries[i].codepoint != codepoint)
+	{
+		i = (i + 1) & mask;
+	}
+
+	return &entries[i];
+}
+
+static void Wellspring_INTERNAL_AddDynamicEntry(DynamicGlyphs *dynamic, uint32_t codepoint, uint32_t index)
+{
+	DynamicEntry *entries, *entry;
+	uint32_t capacity, i;
+
+	/* Keep the table at most half full */
+	if ((dynamic->entryCount + 1) * 2 > dynamic->entryCapacity)
+	{
+		capacity = dynamic->entryCapacity * 2;
+		entries = Wellspring_malloc(sizeof(DynamicEntry) * capacity);
+		Wellspring_memset(entries, 0xFF, sizeof(DynamicEntry) * capacity);
+
+		for (i = 0; i < dynamic->entryCapacity; i += 1)
+		{
+			if (dynamic->entries[i].codepoint != DYNAMIC_EMPTY_CODEPOINT)
+			{
+				*Wellspring_INTERNAL_FindDynamicEntry(entries, capacity, dynamic->entries[i].codepoint) = dynamic->entries[i];
+			}
+		}
+
+		Wellspring_free(dynamic->entries);
+		dynamic->entries = entries;
+		dynamic->entryCapacity = capacity;
+	}
+
+	entry = Wellspring_INTERNAL_FindDynamicEntry(dynamic->entries, dynamic->entryCapacity, codepoint);
+	entry->codepoint = codepoint;
+	entry->index = index;
+	dynamic->entryCount += 1;
+}
+
+/* Replaces rects[0] with the bounding rect of the first count rects */
+static void Wellspring_INTERNAL_MergeDirtyRects(Wellspring_DirtyRect *rects, uint32_t count)
+{
+	uint32_t left = rects[0].x;
+	uint32_t top = rects[0].y;
+	uint32_t right = rects[0].x + rects[0].w;
+	uint32_t bottom = rects[0].y + rects[0].h;
+	uint32_t i;
+
+	for (i = 1; i < count; i += 1)
+	{
+		left = Wellspring_min(left, rects[i].x);
+		top = Wellspring_min(top, rects[i].y);
+		right = Wellspring_max(right, rects[i].x + rects[i].w);
+		bottom = Wellspring_max(bottom, rects[i].y + rects[i].h);
+	}
+
+	rects[0].x = left;
+	rects[0].y = top;
+	rects[0].w = right - left;
+	rects[0].h = bottom - top;
+}
+
+static void Wellspring_INTERNAL_AddDirtyRect(DynamicGlyphs *dynamic, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+	Wellspring_DirtyRect *rect;
+
+	if (dynamic->dirtyRectCount == DYNAMIC_MAX_DIRTY_RECTS)
+	{
+		Wellspring_INTERNAL_MergeDirtyRects(dynamic->dirtyRects, dynamic->dirtyRectCount);
+		dynamic->dirtyRectCount = 1;
+	}
+
+	rect = &dynamic->dirtyRects[dynamic->dirtyRectCount];
+	rect->x = x;
+	rect->y = y;
+	rect->w = w;
+	rect->h = h;
+	dynamic->dirtyRectCount += 1;
+}
+
+/* Called with the lock held for writing.
+ * Returns GLYPH_SLOT_NONE if the codepoint can't be added to the page.
+ */
+static uint32_t Wellspring_INTERNAL_RasterizeDynamicGlyph(DynamicGlyphs *dynamic, uint32_t codepoint)
+{
+	GlyphMetrics *metrics;
+	AtlasRect *atlasRect;
+	stbrp_rect packRect;
+	uint8_t *sdf;
+	int glyph, width, height;
+	uint32_t index = dynamic->glyphCount;
+
+	glyph = stbtt_FindGlyphIndex(&dynamic->fontInfo, (int) codepoint);
+
+	if (glyph == 0 || IsWhitespace(codepoint) || index == dynamic->glyphCapacity)
+	{
+		return GLYPH_SLOT_NONE;
+	}
+
+	metrics = &dynamic->metrics[index];
+	atlasRect = &dynamic->atlasRects[index];
+	Wellspring_memset(atlasRect, 0, sizeof(AtlasRect));
+
+	sdf = Wellspring_INTERNAL_RasterizeSDF(&dynamic->rasterizer, glyph, metrics, &width, &height);
+
+	/* Glyphs without an outline still advance */
+	if (sdf != NULL)
+	{
+		/* A texel of gap keeps filtering from reaching the neighbours */
+		packRect.id = 0;
+		packRect.w = width + 1;
+		packRect.h = height + 1;
+		stbrp_pack_rects(&dynamic->packContext, &packRect, 1);
+
+		if (!packRect.was_packed)
+		{
+			if (!dynamic->full)
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Dynamic glyph page is full!");
+				dynamic->full = 1;
+			}
+
+			stbtt_FreeSDF(sdf, NULL);
+			return GLYPH_SLOT_NONE;
+		}
+
+		Wellspring_INTERNAL_CopySDF(sdf, width, height, dynamic->pixels, dynamic->width, packRect.x, packRect.y);
+		stbtt_FreeSDF(sdf, NULL);
+
+		Wellspring_INTERNAL_SetAtlasRect(atlasRect, packRect.x, dynamic->top + packRect.y, width, height);
+		Wellspring_INTERNAL_AddDirtyRect(dynamic, packRect.x, packRect.y, width, height);
+	}
+
+	dynamic->glyphCount += 1;
+	return index;
+}
+
+/* Failures are remembered too, so each codepoint is rasterized at most once */
+static GlyphMetrics* Wellspring_INTERNAL_FindDynamicGlyph(DynamicGlyphs *dynamic, uint32_t codepoint)
+{
+	DynamicEntry *entry;
+	uint32_t index;
+	uint8_t found;
+
+	SDL_LockRWLockForReading(dynamic->lock);
+	entry = Wellspring_INTERNAL_FindDynamicEntry(dynamic->entries, dynamic->entryCapacity, codepoint);
+	found = entry->codepoint == codepoint;
+	index = entry->index;
+	SDL_UnlockRWLock(dynamic->lock);
+
+	if (!found)
+	{
+		SDL_LockRWLockForWriting(dynamic->lock);
+
+		/* Another thread may have added it in between */
+		entry = Wellspring_INTERNAL_FindDynamicEntry(dynamic->entries, dynamic->entryCapacity, codepoint);
+		if (entry->codepoint == codepoint)
+		{
+			index = entry->index;
+		}
+		else
+		{
+			Wellspring_INTERNAL_BeginZone(ZONE_RASTERIZE_GLYPH);
+			index = Wellspring_INTERNAL_RasterizeDynamicGlyph(dynamic, codepoint);
+			Wellspring_INTERNAL_AddDynamicEntry(dynamic, codepoint, index);
+			Wellspring_INTERNAL_EndZone(ZONE_RASTERIZE_GLYPH);
+		}
+
+		SDL_UnlockRWLock(dynamic->lock);
+	}
+
+	return index == GLYPH_SLOT_NONE ? NULL : &dynamic->metrics[index];
+}
+
+static void Wellspring_INTERNAL_DestroyDynamicGlyphs(DynamicGlyphs *dynamic)
+{
+	SDL_DestroyRWLock(dynamic->lock);
+	Wellspring_free(dynamic->fontBytes);
+	Wellspring_free(dynamic->pixels);
+	Wellspring_free(dynamic->packNodes);
+	Wellspring_free(dynamic->entries);
+	Wellspring_free(dynamic->metrics);
+	Wellspring_free(dynamic);
+}
+
+uint8_t Wellspring_EnableDynamicGlyphs(
+	Wellspring_Font *font,
+	const uint8_t *fontBytes,
+	uint32_t fontBytesLength,
+	uint32_t pageHeight
+) {
+	Font *myFont = (Font*) font;
+	DynamicGlyphs *dynamic;
+	uint32_t cell;
+
+	if (myFont->dynamic != NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Dynamic glyphs are already enabled!");
+		return 0;
+	}
+
+	if (fontBytes == NULL || fontBytesLength == 0 || pageHeight == 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Dynamic glyphs need a font file and a page height!");
+		return 0;
+	}
+
+	/* Atlas rects are stored in 16 bits */
+	if (((uint64_t) myFont->packer.pages[0].height + pageHeight) * ATLAS_UNITS_PER_TEXEL > UINT16_MAX)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Dynamic glyph page is too tall!");
+		return 0;
+	}
+
+	dynamic = Wellspring_malloc(sizeof(DynamicGlyphs));
+	dynamic->fontBytes = Wellspring_malloc(fontBytesLength);
+	Wellspring_memcpy(dynamic->fontBytes, fontBytes, fontBytesLength);
+
+	if (!stbtt_InitFont(&dynamic->fontInfo, dynamic->fontBytes, 0))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Font file is invalid! Bailing!");
+		Wellspring_free(dynamic->fontBytes);
+		Wellspring_free(dynamic);
+		return 0;
+	}
+
+	Wellspring_INTERNAL_InitSdfRasterizer(&dynamic->rasterizer, &dynamic->fontInfo, myFont->pixelsPerEm, myFont->distanceRange);
+
+	dynamic->top = myFont->packer.pages[0].height;
+	dynamic->width = myFont->packer.pages[0].width;
+	dynamic->height = pageHeight;
+	dynamic->pixels = Wellspring_malloc((size_t) dynamic->width * dynamic->height * 4);
+	Wellspring_memset(dynamic->pixels, 0, (size_t) dynamic->width * dynamic->height * 4);
+	dynamic->packNodes = Wellspring_malloc(sizeof(stbrp_node) * dynamic->width);
+	stbrp_init_target(&dynamic->packContext, (int) dynamic->width, (int) dynamic->height, dynamic->packNodes, (int) dynamic->width);
+	dynamic->full = 0;
+
+	dynamic->lock = SDL_CreateRWLock();
+	dynamic->entries = Wellspring_malloc(sizeof(DynamicEntry) * DYNAMIC_INITIAL_ENTRY_CAPACITY);
+	Wellspring_memset(dynamic->entries, 0xFF, sizeof(DynamicEntry) * DYNAMIC_INITIAL_ENTRY_CAPACITY);
+	dynamic->entryCount = 0;
+	dynamic->entryCapacity = DYNAMIC_INITIAL_ENTRY_CAPACITY;
+
+	/* Every outline is at least one texel plus padding on each side */
+	cell = 2 * dynamic->rasterizer.padding + 2;
+	dynamic->glyphCapacity = Wellspring_max((dynamic->width / cell) * (dynamic->height / cell), 1);
+	dynamic->metrics = Wellspring_malloc((sizeof(GlyphMetrics) + sizeof(AtlasRect)) * dynamic->glyphCapacity);
+	dynamic->atlasRects = (AtlasRect*) (dynamic->metrics + dynamic->glyphCapacity);
+	dynamic->glyphCount = 0;
+	dynamic->dirtyRectCount = 0;
+
+	Wellspring_INTERNAL_SetPageSize(&myFont->packer.pages[0], dynamic->width, dynamic->top + pageHeight);
+	myFont->dynamic = dynamic;
+
+	return 1;
+}
+
+uint8_t Wellspring_GetDynamicGlyphPage(
+	Wellspring_Font *font,
+	Wellspring_DynamicGlyphPage *pPage
+) {
+	DynamicGlyphs *dynamic = ((Font*) font)->dynamic;
+
+	if (dynamic == NULL)
+	{
+		Wellspring_memset(pPage, 0, sizeof(Wellspring_DynamicGlyphPage));
+		return 0;
+	}
+
+	pPage->pixels = dynamic->pixels;
+	pPage->width = dynamic->width;
+	pPage->height = dynamic->height;
+	pPage->top = dynamic->top;
+	return 1;
+}
+
+uint32_t Wellspring_TakeDynamicGlyphRects(
+	Wellspring_Font *font,
+	Wellspring_DirtyRect *rects,
+	uint32_t capacity
+) {
+	DynamicGlyphs *dynamic = ((Font*) font)->dynamic;
+	uint32_t count;
+
+	if (dynamic == NULL || capacity == 0)
+	{
+		return 0;
+	}
+
+	SDL_LockRWLockForWriting(dynamic->lock);
+
+	count = dynamic->dirtyRectCount;
+	if (count > capacity)
+	{
+		Wellspring_INTERNAL_MergeDirtyRects(dynamic->dirtyRects + capacity - 1, count - capacity + 1);
+		count = capacity;
+	}
+
+	Wellspring_memcpy(rects, dynamic->dirtyRects, sizeof(Wellspring_DirtyRect) * count);
+	dynamic->dirtyRectCount = 0;
+
+	SDL_UnlockRWLock(dynamic->lock);
+
+	return count;
+}
+
+/* Statistics */
+
+#ifdef WELLSPRING_STATS
+#define Wellspring_StatAdd(counter, value) ((counter) += (value))
+#else
+#define Wellspring_StatAdd(counter, value)
+#endif
+
+#define MISSING_CODEPOINT_INITIAL_CAPACITY 64
+
+static inline void Wellspring_INTERNAL_CountLayoutCall(Font *font)
+{
+#ifdef WELLSPRING_STATS
+	SDL_AddAtomicInt(&font->layoutCalls, 1);
+#endif
+}
+
+#ifdef WELLSPRING_STATS
+static Wellspring_MissingCodepoint* Wellspring_INTERNAL_FindMissingCodepoint(
+	Wellspring_MissingCodepoint *entries,
+	uint32_t capacity,
+	uint32_t codepoint
+) {
+	uint32_t mask = capacity - 1;
+	uint32_t i = (codepoint * 2654435761u) & mask;
+
+	while (entries[i].count != 0 && entries[i].codepoint != codepoint)
+	{
+		i = (i + 1) & mask;
+	}
+
+	return &entries[i];
+}
+#endif
+
+static void Wellspring_INTERNAL_CountMissingCodepoint(Font *font, uint32_t codepoint)
+{
+#ifdef WELLSPRING_STATS
+	Wellspring_MissingCodepoint *entries, *entry;
+	uint32_t capacity, i;
+
+	SDL_LockSpinlock(&font->missingLock);
+
+	/* Keep the table at most half full */
+	if ((font->missingCodepointCount + 1) * 2 > font->missingCodepointCapacity)
+	{
+		capacity = font->missingCodepointCapacity == 0 ? MISSING_CODEPOINT_INITIAL_CAPACITY : font->missingCodepointCapacity * 2;
+		entries = Wellspring_malloc(sizeof(Wellspring_MissingCodepoint) * capacity);
+		Wellspring_memset(entries, 0, sizeof(Wellspring_MissingCodepoint) * capacity);
+
+		for (i = 0; i < font->missingCodepointCapacity; i += 1)
+		{
+			if (font->missingCodepoints[i].count != 0)
+			{
+				*Wellspring_INTERNAL_FindMissingCodepoint(entries, capacity, font->missingCodepoints[i].codepoint) = font->missingCodepoints[i];
+			}
+		}
+
+		Wellspring_free(font->missingCodepoints);
+		font->missingCodepoints = entries;
+		font->missingCodepointCapacity = capacity;
+	}
+
+	entry = Wellspring_INTERNAL_FindMissingCodepoint(font->missingCodepoints, font->missingCodepointCapacity, codepoint);
+	if (entry->count == 0)
+	{
+		entry->codepoint = codepoint;
+		font->missingCodepointCount += 1;
+	}
+	entry->count += 1;
+	font->missingGlyphs += 1;
+
+	SDL_UnlockSpinlock(&font->missingLock);
+#endif
+}
+
+/* Growth can happen during concurrent appends, so this always takes the stats lock */
+static void Wellspring_INTERNAL_CountGrowth(Batch *batch)
+{
+#ifdef WELLSPRING_STATS
+	SDL_LockSpinlock(&batch->statsLock);
+	batch->stats.reallocations += 1;
+	batch->stats.peakVertexCapacity = Wellspring_max(batch->stats.peakVertexCapacity, batch->vertexCapacity);
+	batch->stats.peakChunkCapacity = Wellspring_max(batch->stats.peakChunkCapacity, batch->chunkCapacity);
+	SDL_UnlockSpinlock(&batch->statsLock);
+#endif
+}
+
+/* Adds up the layout counters of one or more chunks */
+static void Wellspring_INTERNAL_MergeStats(Batch *batch, const Wellspring_TextBatchStats *stats, uint8_t concurrent)
+{
+#ifdef WELLSPRING_STATS
+	if (concurrent)
+	{
+		SDL_LockSpinlock(&batch->statsLock);
+	}
+
+	batch->stats.glyphsEmitted += stats->glyphsEmitted;
+	batch->stats.chunksAdded += stats->chunksAdded;
+	batch->stats.chunksReused += stats->chunksReused;
+	batch->stats.missingGlyphs += stats->missingGlyphs;
+	batch->stats.kerningLookups += stats->kerningLookups;
+	batch->stats.utf8Rejects += stats->utf8Rejects;
+
+	if (concurrent)
+	{
+		SDL_UnlockSpinlock(&batch->statsLock);
+	}
+#endif
+}
+
+uint8_t Wellspring_GetTextBatchStats(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_TextBatchStats *pStats
+) {
+#ifdef WELLSPRING_STATS
+	Batch *batch = (Batch*) textBatch;
+
+	*pStats = batch->stats;
+	/* Peaks are only recorded on growth, so include the starting capacity */
+	pStats->peakVertexCapacity = Wellspring_max(pStats->peakVertexCapacity, batch->vertexCapacity);
+	pStats->peakChunkCapacity = Wellspring_max(pStats->peakChunkCapacity, batch->chunkCapacity);
+	return 1;
+#else
+	Wellspring_memset(pStats, 0, sizeof(Wellspring_TextBatchStats));
+	return 0;
+#endif
+}
+
+uint8_t Wellspring_GetFontStats(
+	Wellspring_Font *font,
+	Wellspring_FontStats *pStats
+) {
+#ifdef WELLSPRING_STATS
+	Font *myFont = (Font*) font;
+
+	pStats->layoutCalls = (uint32_t) SDL_GetAtomicInt(&myFont->layoutCalls);
+
+	SDL_LockSpinlock(&myFont->missingLock);
+	pStats->missingCodepointCount = myFont->missingCodepointCount;
+	pStats->missingGlyphs = myFont->missingGlyphs;
+	SDL_UnlockSpinlock(&myFont->missingLock);
+
+	pStats->dynamicGlyphs = 0;
+	if (myFont->dynamic != NULL)
+	{
+		SDL_LockRWLockForReading(myFont->dynamic->lock);
+		pStats->dynamicGlyphs = myFont->dynamic->glyphCount;
+		SDL_UnlockRWLock(myFont->dynamic->lock);
+	}
+	return 1;
+#else
+	Wellspring_memset(pStats, 0, sizeof(Wellspring_FontStats));
+	return 0;
+#endif
+}
+
+#ifdef WELLSPRING_STATS
+static int Wellspring_INTERNAL_CompareMissingCodepoints(const void *a, const void *b)
+{
+	const Wellspring_MissingCodepoint *entryA = (const Wellspring_MissingCodepoint*) a;
+	const Wellspring_MissingCodepoint *entryB = (const Wellspring_MissingCodepoint*) b;
+
+	if (entryA->count != entryB->count)
+	{
+		return entryA->count > entryB->count ? -1 : 1;
+	}
+
+	return entryA->codepoint < entryB->codepoint ? -1 : entryA->codepoint > entryB->codepoint;
+}
+#endif
+
+uint32_t Wellspring_GetFontMissingCodepoints(
+	Wellspring_Font *font,
+	Wellspring_MissingCodepoint *entries,
+	uint32_t capacity
+) {
+#ifdef WELLSPRING_STATS
+	Font *myFont = (Font*) font;
+	Wellspring_MissingCodepoint *sorted;
+	uint32_t count = 0, i;
+
+	SDL_LockSpinlock(&myFont->missingLock);
+
+	sorted = Wellspring_malloc(sizeof(Wellspring_MissingCodepoint) * Wellspring_max(myFont->missingCodepointCount, 1));
+	for (i = 0; i < myFont->missingCodepointCapacity; i += 1)
+	{
+		if (myFont->missingCodepoints[i].count != 0)
+		{
+			sorted[count] = myFont->missingCodepoints[i];
+			count += 1;
+		}
+	}
+
+	SDL_UnlockSpinlock(&myFont->missingLock);
+
+	/* Sorted outside the lock so layout threads aren't held up */
+	Wellspring_sort(sorted, count, sizeof(Wellspring_MissingCodepoint), Wellspring_INTERNAL_CompareMissingCodepoints);
+
+	count = Wellspring_min(count, capacity);
+	Wellspring_memcpy(entries, sorted, sizeof(Wellspring_MissingCodepoint) * count);
+	Wellspring_free(sorted);
+	return count;
+#else
+	return 0;
+#endif
+}
+
+/* Batch storage */
+
+/* Vertex storage is 16-byte aligned for the emission kernels, which rules out realloc */
+static void Wellspring_INTERNAL_ReserveVertices(Batch *batch, uint32_t vertexCapacity)
+{
+	Wellspring_Vertex *vertices;
+	uint8_t growing;
+
+	if (vertexCapacity <= batch->vertexCapacity)
+	{
+		return;
+	}
+
+	Wellspring_INTERNAL_BeginZone(ZONE_GROW_BATCH);
+
+	if (batch->verticesPerSegment == 0)
+	{
+		/* Retained batches also have to keep last frame's vertices */
+		vertices = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * vertexCapacity);
+		Wellspring_memcpy(vertices, batch->vertices, sizeof(Wellspring_Vertex) * Wellspring_max(batch->vertexCount, batch->retainedVertexCount));
+		Wellspring_aligned_free(batch->vertices);
+		batch->vertices = vertices;
+		batch->vertexCapacity = vertexCapacity;
+		Wellspring_INTERNAL_CountGrowth(batch);
+		Wellspring_INTERNAL_EndZone(ZONE_GROW_BATCH);
+		Wellspring_INTERNAL_Plot(PLOT_VERTEX_CAPACITY, batch->vertexCapacity);
+		return;
+	}
+
+	/* A new segmented batch allocating its first segment isn't growth */
+	growing = batch->vertexCapacity > 0;
+
+	while (batch->vertexCapacity < vertexCapacity)
+	{
+		if (batch->segmentCount == batch->segmentCapacity)
+		{
+			/* Only the segment table moves, the vertices stay put */
+			batch->segmentCapacity = batch->segmentCapacity == 0 ? 8 : batch->segmentCapacity * 2;
+			batch->segments = Wellspring_realloc(batch->segments, sizeof(Wellspring_Vertex*) * batch->segmentCapacity);
+		}
+
+		batch->segments[batch->segmentCount] = Wellspring_aligned_alloc(
+			VERTEX_ALIGNMENT,
+			sizeof(Wellspring_Vertex) * batch->verticesPerSegment
+		);
+		batch->segmentCount += 1;
+		batch->vertexCapacity += batch->verticesPerSegment;
+	}
+
+	if (growing)
+	{
+		Wellspring_INTERNAL_CountGrowth(batch);
+	}
+
+	Wellspring_INTERNAL_EndZone(ZONE_GROW_BATCH);
+	Wellspring_INTERNAL_Plot(PLOT_VERTEX_CAPACITY, batch->vertexCapacity);
+}
+
+/* Releases storage beyond vertexCapacity. The batch must be empty. */
+static void Wellspring_INTERNAL_TrimVertices(Batch *batch, uint32_t vertexCapacity)
+{
+	if (batch->verticesPerSegment == 0)
+	{
+		if (vertexCapacity < batch->vertexCapacity)
+		{
+			Wellspring_aligned_free(batch->vertices);
+			batch->vertices = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * vertexCapacity);
+			batch->vertexCapacity = vertexCapacity;
+		}
+		return;
+	}
+
+	while (
+		batch->segmentCount > 1 &&
+		batch->vertexCapacity - batch->verticesPerSegment >= vertexCapacity
+	) {
+		batch->segmentCount -= 1;
+		Wellspring_aligned_free(batch->segments[batch->segmentCount]);
+		batch->vertexCapacity -= batch->verticesPerSegment;
+	}
+}
+
+static inline Wellspring_Vertex* Wellspring_INTERNAL_GetVertex(Batch *batch, uint32_t vertexIndex)
+{
+	if (batch->verticesPerSegment == 0)
+	{
+		return &batch->vertices[vertexIndex];
+	}
+
+	return &batch->segments[vertexIndex / batch->verticesPerSegment][vertexIndex % batch->verticesPerSegment];
+}
+
+/* Returns storage for the four vertices of the next quad */
+static inline Wellspring_Vertex* Wellspring_INTERNAL_PushQuad(Batch *batch)
+{
+	Wellspring_Vertex *vertices;
+
+	if (batch->vertexCount + 4 > batch->vertexCapacity)
+	{
+		/* Contiguous batches double, segmented batches add a single segment */
+		Wellspring_INTERNAL_ReserveVertices(
+			batch,
+			batch->verticesPerSegment == 0 ? batch->vertexCapacity * 2 : batch->vertexCount + 4
+		);
+	}
+
+	vertices = Wellspring_INTERNAL_GetVertex(batch, batch->vertexCount);
+	batch->vertexCount += 4;
+	return vertices;
+}
+
+static inline Chunk* Wellspring_INTERNAL_PushChunk(Batch *batch)
+{
+	if (batch->chunkCount == batch->chunkCapacity)
+	{
+		Wellspring_INTERNAL_BeginZone(ZONE_GROW_BATCH);
+		batch->chunkCapacity = batch->chunkCapacity == 0 ? INITIAL_QUAD_CAPACITY : batch->chunkCapacity * 2;
+		batch->chunks = Wellspring_realloc(batch->chunks, sizeof(Chunk) * batch->chunkCapacity);
+		Wellspring_INTERNAL_CountGrowth(batch);
+		Wellspring_INTERNAL_EndZone(ZONE_GROW_BATCH);
+	}
+
+	batch->chunkCount += 1;
+	return &batch->chunks[batch->chunkCount - 1];
+}
+
+static void Wellspring_INTERNAL_MarkDirty(Batch *batch, uint32_t firstVertex, uint32_t vertexCount)
+{
+	Wellspring_VertexRange *last;
+
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	if (batch->dirtyRangeCount > 0)
+	{
+		last = &batch->dirtyRanges[batch->dirtyRangeCount - 1];
+		if (last->firstVertex + last->vertexCount == firstVertex)
+		{
+			last->vertexCount += vertexCount;
+			return;
+		}
+	}
+
+	if (batch->dirtyRangeCount == batch->dirtyRangeCapacity)
+	{
+		batch->dirtyRangeCapacity = batch->dirtyRangeCapacity == 0 ? 16 : batch->dirtyRangeCapacity * 2;
+		batch->dirtyRanges = Wellspring_realloc(batch->dirtyRanges, sizeof(Wellspring_VertexRange) * batch->dirtyRangeCapacity);
+	}
+
+	batch->dirtyRanges[batch->dirtyRangeCount].firstVertex = firstVertex;
+	batch->dirtyRanges[batch->dirtyRangeCount].vertexCount = vertexCount;
+	batch->dirtyRangeCount += 1;
+}
+
+Wellspring_TextBatch* Wellspring_CreateTextBatch(void)
+{
+	Batch *batch = Wellspring_malloc(sizeof(Batch));
+	Wellspring_memset(batch, 0, sizeof(Batch));
+
+	batch->vertexCapacity = INITIAL_QUAD_CAPACITY * 4;
+	batch->vertices = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * batch->vertexCapacity);
+	batch->growLock = SDL_CreateRWLock();
+
+	return (Wellspring_TextBatch*) batch;
+}
+
+Wellspring_TextBatch* Wellspring_CreateSegmentedTextBatch(uint32_t verticesPerSegment)
+{
+	Batch *batch = Wellspring_malloc(sizeof(Batch));
+	Wellspring_memset(batch, 0, sizeof(Batch));
+
+	/* Quads must never straddle two segments */
+	verticesPerSegment = (verticesPerSegment + 3) & ~3u;
+	if (verticesPerSegment == 0)
+	{
+		verticesPerSegment = INITIAL_QUAD_CAPACITY * 4;
+	}
+
+	batch->verticesPerSegment = verticesPerSegment;
+	Wellspring_INTERNAL_ReserveVertices(batch, verticesPerSegment);
+	batch->growLock = SDL_CreateRWLock();
+
+	return (Wellspring_TextBatch*) batch;
+}
+
+void Wellspring_StartTextBatch(
+	Wellspring_TextBatch *textBatch
+) {
+	Batch *batch = (Batch*) textBatch;
+
+	if (batch->retained)
+	{
+		batch->retainedChunkCount = batch->chunkCount;
+		batch->retainedVertexCount = batch->vertexCount;
+	}
+
+	batch->vertexCount = 0;
+	batch->chunkCount = 0;
+	batch->drawRangeCount = 0;
+	batch->dirtyRangeCount = 0;
+	batch->freeRangeCount = 0;
+	batch->moveCount = 0;
+	SDL_SetAtomicInt(&batch->concurrentVertexCount, 0);
+	SDL_SetAtomicInt(&batch->concurrentChunkCount, 0);
+}
+
+void Wellspring_SetTextBatchRetained(
+	Wellspring_TextBatch *textBatch,
+	uint8_t retained
+) {
+	Batch *batch = (Batch*) textBatch;
+	batch->retained = retained;
+	batch->retainedChunkCount = 0;
+	batch->retainedVertexCount = 0;
+}
+
+void Wellspring_ReserveTextBatch(
+	Wellspring_TextBatch *textBatch,
+	uint32_t vertexCount
+) {
+	Wellspring_INTERNAL_ReserveVertices((Batch*) textBatch, (vertexCount + 3) & ~3u);
+}
+
+static float Wellspring_INTERNAL_GetVerticalAlignOffset(
+	Font *font,
+	Wellspring_VerticalAlignment verticalAlignment,
+	float scale
+) {
+	if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_BASELINE)
+	{
+		return 0;
+	}
+	else if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_TOP)
+	{
+		return scale * font->ascender;
+	}
+	else if (verticalAlignment == WELLSPRING_VERTICALALIGNMENT_MIDDLE)
+	{
+		return scale * (font->ascender + font->descender) / 2.0f;
+	}
+	else /* BOTTOM */
+	{
+		return scale * font->descender;
+	}
+}
+
+static inline GlyphMetrics* Wellspring_INTERNAL_FindGlyph(Packer *packer, uint32_t codepoint)
+{
+	uint32_t i;
+
+	for (i = 0; i < packer->rangeCount; i += 1)
+	{
+		if (
+			codepoint >= packer->ranges[i].firstCodepoint &&
+			codepoint < packer->ranges[i].firstCodepoint + packer->ranges[i].charCount
+		) {
+			return packer->ranges[i].data + (codepoint - packer->ranges[i].firstCodepoint);
+		}
+	}
+
+	return NULL;
+}
+
+/* Only worth calling when the first glyph has GLYPH_FLAG_KERNING */
+static inline float Wellspring_INTERNAL_GetKerning(const Font *font, const GlyphMetrics *first, const GlyphMetrics *second)
+{
+	const KerningPair *pair = Wellspring_INTERNAL_FindKerningPair(
+		&font->kerning,
+		(uint32_t) (first - font->packer.metrics),
+		(uint32_t) (second - font->packer.metrics)
+	);
+
+	return pair->first == KERNING_EMPTY_GLYPH ? 0 : pair->advance;
+}
+
+static inline void Wellspring_INTERNAL_ResolveGlyph(Font *font, uint32_t codepoint, ResolvedGlyph *glyph)
+{
+	glyph->codepoint = codepoint;
+	glyph->metrics = NULL;
+
+	if (IsNewline(codepoint))
+	{
+		glyph->type = GLYPH_TYPE_NEWLINE;
+		return;
+	}
+
+	glyph->metrics = Wellspring_INTERNAL_FindGlyph(&font->packer, codepoint);
+
+	if (glyph->metrics == NULL && font->dynamic != NULL)
+	{
+		glyph->metrics = Wellspring_INTERNAL_FindDynamicGlyph(font->dynamic, codepoint);
+		glyph->type = glyph->metrics != NULL ? GLYPH_TYPE_DYNAMIC : GLYPH_TYPE_MISSING;
+	}
+	else if (glyph->metrics == NULL)
+	{
+		glyph->type = GLYPH_TYPE_MISSING;
+	}
+	else if (glyph->metrics->flags & GLYPH_FLAG_WHITESPACE)
+	{
+		glyph->type = GLYPH_TYPE_WHITESPACE;
+	}
+	else
+	{
+		glyph->type = GLYPH_TYPE_VISIBLE;
+	}
+}
+
+/* Prepared text skips decoding and lookups entirely */
+static inline uint8_t Wellspring_INTERNAL_ReadGlyph(TextReader *reader, Font *font, ResolvedGlyph *glyph)
+{
+	const GlyphSlot *slot;
+	uint32_t codepoint = 0;
+
+	if (reader->encoding == TEXT_ENCODING_GLYPHS)
+	{
+		if (reader->index >= reader->length)
+		{
+			return 0;
+		}
+
+		slot = &((const GlyphSlot*) reader->data)[reader->index];
+		reader->index += 1;
+
+		glyph->type = (GlyphType) slot->type;
+		glyph->codepoint = slot->type == GLYPH_TYPE_MISSING ? slot->value : 0;
+		glyph->metrics = NULL;
+
+		if (slot->type == GLYPH_TYPE_WHITESPACE || slot->type == GLYPH_TYPE_VISIBLE)
+		{
+			glyph->metrics = font->packer.metrics + slot->value;
+		}
+		else if (slot->type == GLYPH_TYPE_DYNAMIC)
+		{
+			glyph->metrics = font->dynamic->metrics + slot->value;
+		}
+		return 1;
+	}
+
+	if (!Wellspring_INTERNAL_ReadCodepoint(reader, &codepoint))
+	{
+		return 0;
+	}
+
+	Wellspring_INTERNAL_ResolveGlyph(font, codepoint, glyph);
+	return 1;
+}
+
+/* Measurement only needs the quad's position, so this never reads the atlas rect */
+static void GetPackedQuad(const GlyphMetrics *b, float scale, float *xPos, float *yPos, Quad *q)
+{
+	float planeScale = scale / PLANE_UNITS_PER_EM;
+
+	float pl, pb, pr, pt;
+
+	pl = *xPos + b->planeLeft * planeScale;
+	pb = *yPos + b->planeBottom * planeScale;
+	pr = *xPos + b->planeRight * planeScale;
+	pt = *yPos + b->planeTop * planeScale;
+
+	q->x0 = pl;
+	q->y0 = pt;
+	q->x1 = pr;
+	q->y1 = pb;
+
+	*xPos += b->xAdvance * scale;
+}
+
+static void Wellspring_INTERNAL_GetAffine(const Wellspring_Transform *transform, Affine *affine)
+{
+	float cosTheta = Wellspring_cosf(transform->rotation);
+	float sinTheta = Wellspring_sinf(transform->rotation);
+
+	affine->m11 = transform->scaleX * cosTheta;
+	affine->m12 = transform->scaleX * sinTheta;
+	affine->m21 = -transform->scaleY * sinTheta;
+	affine->m22 = transform->scaleY * cosTheta;
+	affine->dx = transform->translateX;
+	affine->dy = transform->translateY;
+}
+
+/* Quad emission kernels
+ *
+ * Each kernel expands one packed glyph at the given pen position into the four
+ * vertices of its quad, in the order (x0, y0), (x0, y1), (x1, y0), (x1, y1).
+ * The scalar kernel is the reference implementation, the SIMD kernels must
+ * produce bit-identical output. That only holds without FMA contraction, so
+ * builds that don't use the CMake project need -ffp-contract=off too.
+ */
+
+typedef struct QuadEmitter
+{
+	float scale;
+	float planeScale; /* scale per plane unit */
+	const AtlasPage *pages; /* indexed by the glyph's page */
+	const Affine *affine; /* NULL for untransformed output */
+	uint32_t chunkIndex;
+} QuadEmitter;
+
+static inline void EmitQuad_Scalar(
+	const QuadEmitter *emitter,
+	const GlyphMetrics *metrics,
+	const AtlasRect *atlasRect,
+	float x,
+	float y,
+	Wellspring_Vertex *vertices
+) {
+	const AtlasPage *page = &emitter->pages[metrics->page];
+	float xs[4], ys[4], us[4], vs[4];
+	float x0 = x + metrics->planeLeft * emitter->planeScale;
+	float y0 = y + metrics->planeTop * emitter->planeScale;
+	float x1 = x + metrics->planeRight * emitter->planeScale;
+	float y1 = y + metrics->planeBottom * emitter->planeScale;
+	float s0 = atlasRect->left * page->atlasScaleX;
+	float t0 = atlasRect->top * page->atlasScaleY;
+	float s1 = atlasRect->right * page->atlasScaleX;
+	float t1 = atlasRect->bottom * page->atlasScaleY;
+	uint32_t i;
+
+	xs[0] = x0; ys[0] = y0; us[0] = s0; vs[0] = t0;
+	xs[1] = x0; ys[1] = y1; us[1] = s0; vs[1] = t1;
+	xs[2] = x1; ys[2] = y0; us[2] = s1; vs[2] = t0;
+	xs[3] = x1; ys[3] = y1; us[3] = s1; vs[3] = t1;
+
+	for (i = 0; i < 4; i += 1)
+	{
+		if (emitter->affine != NULL)
+		{
+			const Affine *affine = emitter->affine;
+			vertices[i].x = (affine->m11 * xs[i] + affine->m21 * ys[i]) + affine->dx;
+			vertices[i].y = (affine->m12 * xs[i] + affine->m22 * ys[i]) + affine->dy;
+		}
+		else
+		{
+			vertices[i].x = xs[i];
+			vertices[i].y = ys[i];
+		}
+
+		vertices[i].u = us[i];
+		vertices[i].v = vs[i];
+		vertices[i].chunkIndex = emitter->chunkIndex;
+		vertices[i].page = metrics->page;
+	}
+}
+
+#if defined(SDL_SSE2_INTRINSICS)
+
+/* Four vertices are 96 bytes, which is exactly six 16-byte stores.
+ * Quads always start on a multiple of four vertices, so with 16-byte aligned
+ * vertex storage every store is aligned.
+ */
+static inline void EmitQuad_SSE2(
+	const QuadEmitter *emitter,
+	const GlyphMetrics *metrics,
+	const AtlasRect *atlasRect,
+	float x,
+	float y,
+	Wellspring_Vertex *vertices
+) {
+	/* Both rects are four 16-bit values: widen to 32 bits, zero extending the
+	 * atlas rect and sign extending the plane rect.
+	 */
+	__m128i atlasUnits = _mm_loadl_epi64((const __m128i*) atlasRect);
+	__m128i planeUnits = _mm_loadl_epi64((const __m128i*) &metrics->planeLeft);
+	__m128 atlas = _mm_cvtepi32_ps(_mm_unpacklo_epi16(atlasUnits, _mm_setzero_si128()));  /* left, top, right, bottom */
+	__m128 plane = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(planeUnits, planeUnits), 16));  /* left, top, right, bottom */
+	const AtlasPage *page = &emitter->pages[metrics->page];
+	__m128 pen = _mm_setr_ps(x, y, x, y);
+	__m128 atlasScale = _mm_setr_ps(page->atlasScaleX, page->atlasScaleY, page->atlasScaleX, page->atlasScaleY);
+	__m128 tail = _mm_castsi128_ps(_mm_setr_epi32((int) emitter->chunkIndex, metrics->page, (int) emitter->chunkIndex, metrics->page));  /* chunk, page, chunk, page */
+	__m128 xy = _mm_add_ps(pen, _mm_mul_ps(plane, _mm_set1_ps(emitter->planeScale)));  /* x0, y0, x1, y1 */
+	__m128 st = _mm_mul_ps(atlas, atlasScale);                                          /* s0, t0, s1, t1 */
+	__m128 xs = _mm_shuffle_ps(xy, xy, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 ys = _mm_shuffle_ps(xy, xy, _MM_SHUFFLE(3, 1, 3, 1));
+	__m128 us = _mm_shuffle_ps(st, st, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 vs = _mm_shuffle_ps(st, st, _MM_SHUFFLE(3, 1, 3, 1));
+	float *out = (float*) vertices;
+
+	if (emitter->affine != NULL)
+	{
+		const Affine *affine = emitter->affine;
+		__m128 tx = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(affine->m11)), _mm_mul_ps(ys, _mm_set1_ps(affine->m21))),
+			_mm_set1_ps(affine->dx)
+		);
+		__m128 ty = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(affine->m12)), _mm_mul_ps(ys, _mm_set1_ps(affine->m22))),
+			_mm_set1_ps(affine->dy)
+		);
+		xs = tx;
+		ys = ty;
+	}
+
+	/* After the transpose, each register holds one vertex: x, y, u, v */
+	_MM_TRANSPOSE4_PS(xs, ys, us, vs);
+
+	/* Each pair of vertices is three rows of the 24-float stream, the tail goes between them */
+	_mm_store_ps(out, xs);
+	_mm_store_ps(out + 4, _mm_movelh_ps(tail, ys));
+	_mm_store_ps(out + 8, _mm_movehl_ps(tail, ys));
+	_mm_store_ps(out + 12, us);
+	_mm_store_ps(out + 16, _mm_movelh_ps(tail, vs));
+	_mm_store_ps(out + 20, _mm_movehl_ps(tail, vs));
+}
+
+#define EmitQuad EmitQuad_SSE2
+
+#elif defined(SDL_NEON_INTRINSICS)
+
+static inline void EmitQuad_NEON(
+	const QuadEmitter *emitter,
+	const GlyphMetrics *metrics,
+	const AtlasRect *atlasRect,
+	float x,
+	float y,
+	Wellspring_Vertex *vertices
+) {
+	const AtlasPage *page = &emitter->pages[metrics->page];
+	const float penArray[4] = { x, y, x, y };
+	const float atlasScaleArray[4] = { page->atlasScaleX, page->atlasScaleY, page->atlasScaleX, page->atlasScaleY };
+	float32x4_t atlas = vcvtq_f32_u32(vmovl_u16(vld1_u16(&atlasRect->left)));
+	float32x4_t plane = vcvtq_f32_s32(vmovl_s16(vld1_s16(&metrics->planeLeft)));
+	float32x4_t xy = vaddq_f32(vld1q_f32(penArray), vmulq_n_f32(plane, emitter->planeScale));
+	float32x4_t st = vmulq_f32(atlas, vld1q_f32(atlasScaleArray));
+	float32x4x2_t xyDeinterleaved = vuzpq_f32(xy, xy);  /* (x0, x1, x0, x1), (y0, y1, y0, y1) */
+	float32x4x2_t stDeinterleaved = vuzpq_f32(st, st);
+	float32x4x4_t columns;
+	float interleaved[16];
+	uint32_t i;
+
+	columns.val[0] = vzipq_f32(xyDeinterleaved.val[0], xyDeinterleaved.val[0]).val[0];
+	columns.val[1] = xyDeinterleaved.val[1];
+	columns.val[2] = vzipq_f32(stDeinterleaved.val[0], stDeinterleaved.val[0]).val[0];
+	columns.val[3] = stDeinterleaved.val[1];
+
+	if (emitter->affine != NULL)
+	{
+		const Affine *affine = emitter->affine;
+		float32x4_t tx = vaddq_f32(
+			vaddq_f32(vmulq_n_f32(columns.val[0], affine->m11), vmulq_n_f32(columns.val[1], affine->m21)),
+			vdupq_n_f32(affine->dx)
+		);
+		float32x4_t ty = vaddq_f32(
+			vaddq_f32(vmulq_n_f32(columns.val[0], affine->m12), vmulq_n_f32(columns.val[1], affine->m22)),
+			vdupq_n_f32(affine->dy)
+		);
+		columns.val[0] = tx;
+		columns.val[1] = ty;
+	}
+
+	vst4q_f32(interleaved, columns);
+
+	for (i = 0; i < 4; i += 1)
+	{
+		vst1q_f32(&vertices[i].x, vld1q_f32(interleaved + i * 4));
+		vertices[i].chunkIndex = emitter->chunkIndex;
+		vertices[i].page = metrics->page;
+	}
+}
+
+#define EmitQuad EmitQuad_NEON
+
+#else
+
+#define EmitQuad EmitQuad_Scalar
+
+#endif
+static uint8_t Wellspring_Internal_TextBounds(
+	Font* font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Text *text,
+	Wellspring_Rectangle *pRectangle
+) {
+	TextReader reader;
+	ResolvedGlyph glyph;
+	const GlyphMetrics *previousGlyph = NULL;
+	Quad charQuad;
+	float x = 0, y = 0;
+	float minX = x;
+	float minY = y;
+	float maxX = x;
+	float maxY = y;
+	float startX = x;
+	float advance = 0;
+	float sizeFactor = pixelSize / font->pixelsPerEm;
+
+	y -= Wellspring_INTERNAL_GetVerticalAlignOffset(font, verticalAlignment, sizeFactor * font->scale);
+
+	Wellspring_INTERNAL_StartReading(&reader, text);
+
+	while (Wellspring_INTERNAL_ReadGlyph(&reader, font, &glyph))
+	{
+		if (glyph.type == GLYPH_TYPE_NEWLINE)
+		{
+			y += sizeFactor * font->lineHeight * font->scale;
+			maxY += sizeFactor * font->lineHeight * font->scale;
+			x = 0;
+			previousGlyph = NULL;
+			continue;
+		}
+
+		if (glyph.type == GLYPH_TYPE_MISSING)
+		{
+			// Requested char wasn't packed!
+			// Just treat this like whitespace for now.
+			x += sizeFactor * font->scale * 0.2;
+			maxX += sizeFactor * font->scale * 0.2;
+			previousGlyph = NULL;
+			continue;
+		}
+
+		if (glyph.type == GLYPH_TYPE_WHITESPACE)
+		{
+			x += sizeFactor * font->scale * glyph.metrics->xAdvance;
+			maxX += sizeFactor * font->scale * glyph.metrics->xAdvance;
+			previousGlyph = NULL;
+			continue;
+		}
+
+		if (glyph.type == GLYPH_TYPE_VISIBLE && previousGlyph != NULL && (previousGlyph->flags & GLYPH_FLAG_KERNING))
+		{
+			x += sizeFactor * font->kerningScale * font->scale * Wellspring_INTERNAL_GetKerning(font, previousGlyph, glyph.metrics);
+		}
+
+		GetPackedQuad(
+			glyph.metrics,
+			sizeFactor * font->scale,
+			&x,
+			&y,
+			&charQuad
+		);
+
+		if (charQuad.x0 < minX) { minX = charQuad.x0; }
+		if (charQuad.x1 > maxX) { maxX = charQuad.x1; }
+		if (charQuad.y0 < minY) { minY = charQuad.y0; }
+		if (charQuad.y1 > maxY) { maxY = charQuad.y1; }
+
+		previousGlyph = glyph.metrics;
+	}
+
+	if (reader.rejected)
+	{
+		/* Something went very wrong */
+		return 0;
+	}
+
+	advance = x - startX;
+
+	if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_RIGHT)
+	{
+		minX -= advance;
+		maxX -= advance;
+	}
+	else if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_CENTER)
+	{
+		minX -= advance * 0.5f;
+		maxX -= advance * 0.5f;
+	}
+
+	pRectangle->x = minX;
+	pRectangle->y = minY;
+	pRectangle->w = maxX - minX;
+	pRectangle->h = maxY - minY;
+
+	return 1;
+}
+
+uint8_t Wellspring_TextBounds(
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t* strBytes,
+	uint32_t strLengthInBytes,
+	Wellspring_Rectangle* pRectangle
+) {
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_TEXT_BOUNDS);
+	result = Wellspring_Internal_TextBounds(
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		pRectangle
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_TEXT_BOUNDS);
+
+	return result;
+}
+
+uint8_t Wellspring_TextBoundsUTF16(
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint16_t *str,
+	uint32_t strLength,
+	Wellspring_Rectangle *pRectangle
+) {
+	Text text = Wellspring_INTERNAL_MakeText(str, strLength, TEXT_ENCODING_UTF16);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_TEXT_BOUNDS);
+	result = Wellspring_Internal_TextBounds(
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		pRectangle
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_TEXT_BOUNDS);
+
+	return result;
+}
+
+uint8_t Wellspring_TextBoundsUTF32(
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint32_t *str,
+	uint32_t strLength,
+	Wellspring_Rectangle *pRectangle
+) {
+	Text text = Wellspring_INTERNAL_MakeText(str, strLength, TEXT_ENCODING_UTF32);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_TEXT_BOUNDS);
+	result = Wellspring_Internal_TextBounds(
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		pRectangle
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_TEXT_BOUNDS);
+
+	return result;
+}
+
+/* Prepared text */
+
+static PreparedText* Wellspring_INTERNAL_PrepareText(
+	Font *font,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes
+) {
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+	TextReader reader;
+	ResolvedGlyph glyph;
+	PreparedText *prepared;
+	GlyphSlot *slot;
+	GlyphSlot *slots;
+
+	prepared = Wellspring_malloc(sizeof(PreparedText));
+	prepared->font = font;
+	prepared->slotCount = 0;
+
+	/* There can't be more codepoints than bytes, trimmed below */
+	prepared->slots = Wellspring_malloc(sizeof(GlyphSlot) * Wellspring_max(strLengthInBytes, 1));
+
+	Wellspring_INTERNAL_StartReading(&reader, &text);
+
+	while (Wellspring_INTERNAL_ReadGlyph(&reader, font, &glyph))
+	{
+		slot = &prepared->slots[prepared->slotCount];
+		slot->type = (uint8_t) glyph.type;
+		Wellspring_memset(slot->padding, 0, sizeof(slot->padding));
+
+		if (glyph.type == GLYPH_TYPE_MISSING)
+		{
+			slot->value = glyph.codepoint;
+		}
+		else if (glyph.type == GLYPH_TYPE_DYNAMIC)
+		{
+			slot->value = (uint32_t) (glyph.metrics - font->dynamic->metrics);
+		}
+		else if (glyph.metrics != NULL)
+		{
+			slot->value = (uint32_t) (glyph.metrics - font->packer.metrics);
+		}
+		else
+		{
+			slot->value = 0;
+		}
+
+		prepared->slotCount += 1;
+	}
+
+	if (reader.rejected)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid UTF-8 passed to Wellspring_PrepareText!");
+		Wellspring_free(prepared->slots);
+		Wellspring_free(prepared);
+		return NULL;
+	}
+
+	slots = Wellspring_realloc(prepared->slots, sizeof(GlyphSlot) * Wellspring_max(prepared->slotCount, 1));
+	if (slots != NULL)
+	{
+		prepared->slots = slots;
+	}
+
+	return prepared;
+}
+
+Wellspring_PreparedText* Wellspring_PrepareText(
+	Wellspring_Font *font,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes
+) {
+	PreparedText *prepared;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_PREPARE_TEXT);
+	prepared = Wellspring_INTERNAL_PrepareText((Font*) font, strBytes, strLengthInBytes);
+	Wellspring_INTERNAL_EndZone(ZONE_PREPARE_TEXT);
+
+	return (Wellspring_PreparedText*) prepared;
+}
+
+uint8_t Wellspring_TextBoundsPrepared(
+	Wellspring_PreparedText *preparedText,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	Wellspring_Rectangle *pRectangle
+) {
+	PreparedText *prepared = (PreparedText*) preparedText;
+	Text text = Wellspring_INTERNAL_MakeText(prepared->slots, prepared->slotCount, TEXT_ENCODING_GLYPHS);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_TEXT_BOUNDS);
+	result = Wellspring_Internal_TextBounds(
+		prepared->font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		pRectangle
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_TEXT_BOUNDS);
+
+	return result;
+}
+
+static uint64_t Wellspring_INTERNAL_HashChunk(
+	Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Text *text,
+	const Wellspring_Transform *transform
+) {
+	ChunkKey key;
+	uint32_t sizeInBytes = Wellspring_INTERNAL_TextSizeInBytes(text);
+	uint32_t low, high;
+
+	/* Zeroed so padding bytes hash consistently */
+	Wellspring_memset(&key, 0, sizeof(ChunkKey));
+	key.font = font;
+	key.atlasID = font->atlasID;
+	key.pixelSize = pixelSize;
+	key.horizontalAlignment = horizontalAlignment;
+	key.verticalAlignment = verticalAlignment;
+	key.strLengthInBytes = sizeInBytes;
+	key.encoding = text->encoding;
+	if (transform != NULL)
+	{
+		key.hasTransform = 1;
+		key.transform = *transform;
+	}
+
+	low = SDL_murmur3_32(&key, sizeof(ChunkKey), 0);
+	low = SDL_murmur3_32(text->data, sizeInBytes, low);
+	high = SDL_murmur3_32(&key, sizeof(ChunkKey), 0x9E3779B9);
+	high = SDL_murmur3_32(text->data, sizeInBytes, high);
+
+	return ((uint64_t) high << 32) | low;
+}
+
+/* Returns storage for the next quad, appended when there is no cursor */
+static inline Wellspring_Vertex* Wellspring_INTERNAL_NextQuad(Batch *batch, uint32_t *pVertexCursor)
+{
+	Wellspring_Vertex *vertices;
+
+	if (pVertexCursor == NULL)
+	{
+		return Wellspring_INTERNAL_PushQuad(batch);
+	}
+
+	/* Storage was reserved up front, so this only writes vertices */
+	vertices = Wellspring_INTERNAL_GetVertex(batch, *pVertexCursor);
+	*pVertexCursor += 4;
+	return vertices;
+}
+
+/* Appends the chunk's quads to the end of the batch,
+ * or writes them at *pVertexCursor if it is not NULL.
+ */
+static uint8_t Wellspring_INTERNAL_LayoutChunk(
+	Batch *batch,
+	Font *currentFont,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Text *text,
+	const Wellspring_Transform *transform,
+	uint32_t chunkIndex,
+	uint32_t *pVertexCursor,
+	Wellspring_TextBatchStats *pStats
+) {
+	Packer *myPacker = &currentFont->packer;
+	TextReader reader;
+	ResolvedGlyph glyph;
+	const GlyphMetrics *previousGlyph = NULL;
+	Wellspring_Rectangle bounds;
+	float sizeFactor = pixelSize / currentFont->pixelsPerEm;
+	float x = 0, y = 0;
+	float initialX = 0;
+	Affine affine;
+	QuadEmitter emitter;
+	uint32_t firstVertex = batch->vertexCount;
+
+	emitter.scale = sizeFactor * currentFont->scale;
+	emitter.planeScale = emitter.scale / PLANE_UNITS_PER_EM;
+	emitter.pages = myPacker->pages;
+	emitter.affine = NULL;
+	emitter.chunkIndex = chunkIndex;
+
+	if (transform != NULL)
+	{
+		Wellspring_INTERNAL_GetAffine(transform, &affine);
+		emitter.affine = &affine;
+	}
+
+	y -= Wellspring_INTERNAL_GetVerticalAlignOffset(currentFont, verticalAlignment, sizeFactor * currentFont->scale);
+
+	/* FIXME: If we horizontally align, we have to decode and process glyphs twice, very inefficient. */
+	if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_RIGHT)
+	{
+		if (!Wellspring_Internal_TextBounds(currentFont, pixelSize, horizontalAlignment, verticalAlignment, text, &bounds))
+		{
+			/* Something went wrong while calculating bounds. */
+			return 0;
+		}
+
+		initialX = -bounds.w;
+	}
+	else if (horizontalAlignment == WELLSPRING_HORIZONTALALIGNMENT_CENTER)
+	{
+		if (!Wellspring_Internal_TextBounds(currentFont, pixelSize, horizontalAlignment, verticalAlignment, text, &bounds))
+		{
+			/* Something went wrong while calculating bounds. */
+			return 0;
+		}
+
+		initialX = -bounds.w * 0.5f;
+	}
+
+	x = initialX;
+
+	Wellspring_INTERNAL_StartReading(&reader, text);
+
+	while (Wellspring_INTERNAL_ReadGlyph(&reader, currentFont, &glyph))
+	{
+		if (!Wellspring_INTERNAL_EmitsQuad(glyph.type))
+		{
+			if (glyph.type == GLYPH_TYPE_NEWLINE)
+			{
+				y += sizeFactor * currentFont->lineHeight * currentFont->scale;
+				x = initialX;
+			}
+			else if (glyph.type == GLYPH_TYPE_MISSING)
+			{
+				// Requested char wasn't packed!
+				// Just treat this like whitespace for now.
+				Wellspring_StatAdd(pStats->missingGlyphs, 1);
+				Wellspring_INTERNAL_CountMissingCodepoint(currentFont, glyph.codepoint);
+				x += sizeFactor * currentFont->scale * 0.2;
+			}
+			else
+			{
+				x += sizeFactor * currentFont->scale * glyph.metrics->xAdvance;
+			}
+
+			previousGlyph = NULL;
+			continue;
+		}
+
+		if (glyph.type == GLYPH_TYPE_VISIBLE && previousGlyph != NULL && (previousGlyph->flags & GLYPH_FLAG_KERNING))
+		{
+			Wellspring_StatAdd(pStats->kerningLookups, 1);
+			x += sizeFactor * currentFont->kerningScale * currentFont->scale * Wellspring_INTERNAL_GetKerning(currentFont, previousGlyph, glyph.metrics);
+		}
+
+		EmitQuad(
+			&emitter,
+			glyph.metrics,
+			glyph.type == GLYPH_TYPE_DYNAMIC ?
+				currentFont->dynamic->atlasRects + (glyph.metrics - currentFont->dynamic->metrics) :
+				myPacker->atlasRects + (glyph.metrics - myPacker->metrics),
+			x,
+			y,
+			Wellspring_INTERNAL_NextQuad(batch, pVertexCursor)
+		);
+		Wellspring_StatAdd(pStats->glyphsEmitted, 1);
+		x += glyph.metrics->xAdvance * emitter.scale;
+
+		previousGlyph = glyph.metrics;
+	}
+
+	if (reader.rejected)
+	{
+		/* Something went wrong while decoding. */
+		if (pVertexCursor == NULL)
+		{
+			batch->vertexCount = firstVertex;
+			/* Chunks retained past this point may have been overwritten */
+			batch->retainedChunkCount = Wellspring_min(batch->retainedChunkCount, batch->chunkCount);
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint8_t Wellspring_INTERNAL_AddChunkToTextBatch(
+	Batch *batch,
+	Font *currentFont,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Text *text,
+	const Wellspring_Transform *transform
+) {
+	uint32_t firstVertex = batch->vertexCount;
+	Chunk *chunk;
+	uint64_t hash = 0;
+	Wellspring_TextBatchStats layoutStats = { 0 };
+
+	if (batch->retained)
+	{
+		hash = Wellspring_INTERNAL_HashChunk(currentFont, pixelSize, horizontalAlignment, verticalAlignment, text, transform);
+
+		if (batch->chunkCount < batch->retainedChunkCount)
+		{
+			chunk = &batch->chunks[batch->chunkCount];
+
+			/* Same input at the same position, so last frame's vertices are still valid */
+			if (!chunk->removed && chunk->hash == hash && chunk->firstVertex == firstVertex)
+			{
+				batch->vertexCount += chunk->vertexCount;
+				batch->chunkCount += 1;
+				Wellspring_StatAdd(batch->stats.chunksReused, 1);
+				return 1;
+			}
+		}
+	}
+
+	if (!Wellspring_INTERNAL_LayoutChunk(
+		batch,
+		currentFont,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		text,
+		transform,
+		batch->chunkCount,
+		NULL,
+		&layoutStats
+	)) {
+		/* Whatever was emitted before the error has been discarded */
+		Wellspring_StatAdd(batch->stats.utf8Rejects, 1);
+		return 0;
+	}
+
+	Wellspring_StatAdd(layoutStats.chunksAdded, 1);
+	Wellspring_INTERNAL_MergeStats(batch, &layoutStats, 0);
+	Wellspring_INTERNAL_CountLayoutCall(currentFont);
+
+	chunk = Wellspring_INTERNAL_PushChunk(batch);
+	chunk->firstVertex = firstVertex;
+	chunk->vertexCount = batch->vertexCount - firstVertex;
+	chunk->vertexCapacity = chunk->vertexCount;
+	chunk->atlasID = currentFont->atlasID;
+	chunk->multiPage = currentFont->packer.pageCount > 1;
+	chunk->hash = hash;
+	chunk->removed = 0;
+
+	Wellspring_INTERNAL_MarkDirty(batch, firstVertex, chunk->vertexCount);
+
+	return 1;
+}
+
+uint8_t Wellspring_AddChunkToTextBatch(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes
+) {
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNK);
+	result = Wellspring_INTERNAL_AddChunkToTextBatch(
+		(Batch*) textBatch,
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		NULL
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNK);
+
+	return result;
+}
+
+uint8_t Wellspring_AddChunkToTextBatchWithTransform(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+) {
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNK);
+	result = Wellspring_INTERNAL_AddChunkToTextBatch(
+		(Batch*) textBatch,
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNK);
+
+	return result;
+}
+
+uint8_t Wellspring_AddChunkToTextBatchUTF16(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint16_t *str,
+	uint32_t strLength,
+	const Wellspring_Transform *transform
+) {
+	Text text = Wellspring_INTERNAL_MakeText(str, strLength, TEXT_ENCODING_UTF16);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNK);
+	result = Wellspring_INTERNAL_AddChunkToTextBatch(
+		(Batch*) textBatch,
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNK);
+
+	return result;
+}
+
+uint8_t Wellspring_AddChunkToTextBatchUTF32(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint32_t *str,
+	uint32_t strLength,
+	const Wellspring_Transform *transform
+) {
+	Text text = Wellspring_INTERNAL_MakeText(str, strLength, TEXT_ENCODING_UTF32);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNK);
+	result = Wellspring_INTERNAL_AddChunkToTextBatch(
+		(Batch*) textBatch,
+		(Font*) font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNK);
+
+	return result;
+}
+
+uint8_t Wellspring_AddChunkToTextBatchPrepared(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_PreparedText *preparedText,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const Wellspring_Transform *transform
+) {
+	PreparedText *prepared = (PreparedText*) preparedText;
+	Text text = Wellspring_INTERNAL_MakeText(prepared->slots, prepared->slotCount, TEXT_ENCODING_GLYPHS);
+	uint8_t result;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNK);
+	result = Wellspring_INTERNAL_AddChunkToTextBatch(
+		(Batch*) textBatch,
+		prepared->font,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform
+	);
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNK);
+
+	return result;
+}
+
+/* Parallel layout */
+
+typedef struct ParallelLayout
+{
+	Batch *batch;
+	const Wellspring_ChunkDescriptor *descriptors;
+	ParallelChunk *results;
+} ParallelLayout;
+
+/* Counts the quads LayoutChunk will emit, returns 0 if the string fails to decode */
+static uint8_t Wellspring_INTERNAL_CountQuads(
+	Font *font,
+	const Text *text,
+	uint32_t *pQuadCount
+) {
+	TextReader reader;
+	ResolvedGlyph glyph;
+	uint32_t quadCount = 0;
+
+	Wellspring_INTERNAL_StartReading(&reader, text);
+
+	while (Wellspring_INTERNAL_ReadGlyph(&reader, font, &glyph))
+	{
+		quadCount += Wellspring_INTERNAL_EmitsQuad(glyph.type);
+	}
+
+	if (reader.rejected)
+	{
+		return 0;
+	}
+
+	*pQuadCount = quadCount;
+	return 1;
+}
+
+static void WELLSPRINGCALL Wellspring_INTERNAL_CountTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	ParallelLayout *layout = (ParallelLayout*) taskData;
+	const Wellspring_ChunkDescriptor *descriptor;
+	ParallelChunk *result;
+	Text text;
+	uint32_t i;
+
+	for (i = begin; i < end; i += 1)
+	{
+		descriptor = &layout->descriptors[i];
+		result = &layout->results[i];
+		text = Wellspring_INTERNAL_MakeText(descriptor->strBytes, descriptor->strLengthInBytes, TEXT_ENCODING_UTF8);
+
+		result->valid = Wellspring_INTERNAL_CountQuads(
+			(Font*) descriptor->font,
+			&text,
+			&result->quadCount
+		);
+
+		if (result->valid && layout->batch->retained)
+		{
+			result->hash = Wellspring_INTERNAL_HashChunk(
+				(Font*) descriptor->font,
+				descriptor->pixelSize,
+				descriptor->horizontalAlignment,
+				descriptor->verticalAlignment,
+				&text,
+				descriptor->transform
+			);
+		}
+	}
+}
+
+static void WELLSPRINGCALL Wellspring_INTERNAL_FillTask(void *taskData, uint32_t begin, uint32_t end)
+{
+	ParallelLayout *layout = (ParallelLayout*) taskData;
+	const Wellspring_ChunkDescriptor *descriptor;
+	ParallelChunk *result;
+	Wellspring_TextBatchStats layoutStats = { 0 };
+	Text text;
+	uint32_t vertexCursor, i;
+
+	for (i = begin; i < end; i += 1)
+	{
+		descriptor = &layout->descriptors[i];
+		result = &layout->results[i];
+
+		if (!result->fill)
+		{
+			continue;
+		}
+
+		/* The ranges are disjoint and already reserved, so nothing else in the batch is touched */
+		text = Wellspring_INTERNAL_MakeText(descriptor->strBytes, descriptor->strLengthInBytes, TEXT_ENCODING_UTF8);
+		vertexCursor = result->firstVertex;
+		Wellspring_INTERNAL_LayoutChunk(
+			layout->batch,
+			(Font*) descriptor->font,
+			descriptor->pixelSize,
+			descriptor->horizontalAlignment,
+			descriptor->verticalAlignment,
+			&text,
+			descriptor->transform,
+			result->chunkIndex,
+			&vertexCursor,
+			&layoutStats
+		);
+
+		/* Writing past the counted quads would overwrite the next chunk */
+		Wellspring_assert(vertexCursor == result->firstVertex + result->quadCount * 4);
+	}
+
+	Wellspring_INTERNAL_MergeStats(layout->batch, &layoutStats, 1);
+}
+
+uint8_t Wellspring_AddChunksParallel(
+	Wellspring_TextBatch *textBatch,
+	const Wellspring_ChunkDescriptor *chunks,
+	uint32_t chunkCount,
+	Wellspring_ParallelFor parallelFor,
+	void *userdata
+) {
+	Batch *batch = (Batch*) textBatch;
+	ParallelLayout layout;
+	ParallelChunk *result;
+	Chunk *chunk;
+	uint32_t vertexCursor, i;
+	uint8_t success = 1;
+
+	if (chunkCount == 0)
+	{
+		return 1;
+	}
+
+	if (parallelFor == NULL)
+	{
+		parallelFor = Wellspring_INTERNAL_DefaultParallelFor;
+	}
+
+	Wellspring_INTERNAL_BeginZone(ZONE_ADD_CHUNKS_PARALLEL);
+
+	if (chunkCount > batch->parallelChunkCapacity)
+	{
+		batch->parallelChunkCapacity = chunkCount;
+		Wellspring_free(batch->parallelChunks);
+		batch->parallelChunks = Wellspring_malloc(sizeof(ParallelChunk) * chunkCount);
+	}
+
+	layout.batch = batch;
+	layout.descriptors = chunks;
+	layout.results = batch->parallelChunks;
+
+	parallelFor(userdata, chunkCount, Wellspring_INTERNAL_CountTask, &layout);
+
+	/* Hand out vertex ranges and chunk indices in serial order */
+	vertexCursor = batch->vertexCount;
+
+	for (i = 0; i < chunkCount; i += 1)
+	{
+		result = &batch->parallelChunks[i];
+		result->fill = 0;
+
+		if (!result->valid)
+		{
+			Wellspring_StatAdd(batch->stats.utf8Rejects, 1);
+			success = 0;
+			continue;
+		}
+
+		if (batch->retained)
+		{
+			if (batch->chunkCount < batch->retainedChunkCount)
+			{
+				chunk = &batch->chunks[batch->chunkCount];
+
+				/* Same check as Wellspring_INTERNAL_AddChunkToTextBatch */
+				if (!chunk->removed && chunk->hash == result->hash && chunk->firstVertex == vertexCursor)
+				{
+					vertexCursor += chunk->vertexCount;
+					batch->chunkCount += 1;
+					Wellspring_StatAdd(batch->stats.chunksReused, 1);
+					continue;
+				}
+			}
+		}
+		else
+		{
+			result->hash = 0;
+		}
+
+		chunk = Wellspring_INTERNAL_PushChunk(batch);
+		chunk->firstVertex = vertexCursor;
+		chunk->vertexCount = result->quadCount * 4;
+		chunk->vertexCapacity = chunk->vertexCount;
+		chunk->atlasID = ((Font*) chunks[i].font)->atlasID;
+		chunk->multiPage = ((Font*) chunks[i].font)->packer.pageCount > 1;
+		chunk->hash = result->hash;
+		chunk->removed = 0;
+
+		Wellspring_INTERNAL_MarkDirty(batch, chunk->firstVertex, chunk->vertexCount);
+		Wellspring_StatAdd(batch->stats.chunksAdded, 1);
+		Wellspring_INTERNAL_CountLayoutCall((Font*) chunks[i].font);
+
+		result->firstVertex = vertexCursor;
+		result->chunkIndex = batch->chunkCount - 1;
+		result->fill = chunk->vertexCount > 0;
+		vertexCursor += chunk->vertexCount;
+	}
+
+	if (vertexCursor > batch->vertexCapacity)
+	{
+		Wellspring_INTERNAL_ReserveVertices(
+			batch,
+			batch->verticesPerSegment == 0 ? Wellspring_max(vertexCursor, batch->vertexCapacity * 2) : vertexCursor
+		);
+	}
+
+	parallelFor(userdata, chunkCount, Wellspring_INTERNAL_FillTask, &layout);
+
+	batch->vertexCount = vertexCursor;
+
+	Wellspring_INTERNAL_EndZone(ZONE_ADD_CHUNKS_PARALLEL);
+	return success;
+}
+
+/* Concurrent append */
+
+/* Called without the grow lock. Takes it for writing, so no other thread is mid-write while storage moves. */
+static void Wellspring_INTERNAL_GrowConcurrent(Batch *batch, uint32_t vertexEnd, uint32_t chunkEnd)
+{
+	Wellspring_Vertex *vertices;
+	uint32_t vertexCapacity;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_GROW_BATCH);
+	SDL_LockRWLockForWriting(batch->growLock);
+
+	if (vertexEnd > batch->vertexCapacity)
+	{
+		if (batch->verticesPerSegment == 0)
+		{
+			/* Anything below the old capacity may already have been written */
+			vertexCapacity = Wellspring_max(vertexEnd, batch->vertexCapacity * 2);
+			vertices = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * vertexCapacity);
+			Wellspring_memcpy(vertices, batch->vertices, sizeof(Wellspring_Vertex) * batch->vertexCapacity);
+			Wellspring_aligned_free(batch->vertices);
+			batch->vertices = vertices;
+			batch->vertexCapacity = vertexCapacity;
+			Wellspring_INTERNAL_CountGrowth(batch);
+		}
+		else
+		{
+			Wellspring_INTERNAL_ReserveVertices(batch, vertexEnd);
+		}
+	}
+
+	if (chunkEnd > batch->chunkCapacity)
+	{
+		batch->chunkCapacity = Wellspring_max(chunkEnd, batch->chunkCapacity * 2);
+		batch->chunks = Wellspring_realloc(batch->chunks, sizeof(Chunk) * batch->chunkCapacity);
+		Wellspring_INTERNAL_CountGrowth(batch);
+	}
+
+	SDL_UnlockRWLock(batch->growLock);
+	Wellspring_INTERNAL_EndZone(ZONE_GROW_BATCH);
+}
+
+uint8_t Wellspring_AddChunkToTextBatchConcurrent(
+	Wellspring_TextBatch *textBatch,
+	uint64_t orderKey,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+) {
+	Batch *batch = (Batch*) textBatch;
+	Font *currentFont = (Font*) font;
+	Chunk *chunk;
+	uint32_t quadCount, vertexCount, firstVertex, chunkSlot, vertexCursor;
+	uint64_t hash = 0;
+	Wellspring_TextBatchStats layoutStats = { 0 };
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+
+	/* Counting first means a chunk that fails to decode never claims any space */
+	if (!Wellspring_INTERNAL_CountQuads(currentFont, &text, &quadCount))
+	{
+		Wellspring_StatAdd(layoutStats.utf8Rejects, 1);
+		Wellspring_INTERNAL_MergeStats(batch, &layoutStats, 1);
+		return 0;
+	}
+
+	if (batch->retained)
+	{
+		hash = Wellspring_INTERNAL_HashChunk(currentFont, pixelSize, horizontalAlignment, verticalAlignment, &text, transform);
+	}
+
+	vertexCount = quadCount * 4;
+	firstVertex = batch->vertexCount + (uint32_t) SDL_AddAtomicInt(&batch->concurrentVertexCount, (int) vertexCount);
+	chunkSlot = batch->chunkCount + (uint32_t) SDL_AddAtomicInt(&batch->concurrentChunkCount, 1);
+
+	SDL_LockRWLockForReading(batch->growLock);
+
+	while (firstVertex + vertexCount > batch->vertexCapacity || chunkSlot >= batch->chunkCapacity)
+	{
+		SDL_UnlockRWLock(batch->growLock);
+		Wellspring_INTERNAL_GrowConcurrent(batch, firstVertex + vertexCount, chunkSlot + 1);
+		SDL_LockRWLockForReading(batch->growLock);
+	}
+
+	/* chunkIndex is rewritten once the final order is known */
+	vertexCursor = firstVertex;
+	Wellspring_INTERNAL_LayoutChunk(
+		batch,
+		currentFont,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform,
+		chunkSlot,
+		&vertexCursor,
+		&layoutStats
+	);
+
+	chunk = &batch->chunks[chunkSlot];
+	chunk->firstVertex = firstVertex;
+	chunk->vertexCount = vertexCount;
+	chunk->vertexCapacity = vertexCount;
+	chunk->atlasID = currentFont->atlasID;
+	chunk->multiPage = currentFont->packer.pageCount > 1;
+	chunk->hash = hash;
+	chunk->orderKey = orderKey;
+	chunk->removed = 0;
+
+	SDL_UnlockRWLock(batch->growLock);
+
+	Wellspring_StatAdd(layoutStats.chunksAdded, 1);
+	Wellspring_INTERNAL_MergeStats(batch, &layoutStats, 1);
+	Wellspring_INTERNAL_CountLayoutCall(currentFont);
+
+	return 1;
+}
+
+static int Wellspring_INTERNAL_CompareChunkOrder(const void *a, const void *b)
+{
+	const Chunk *chunkA = (const Chunk*) a;
+	const Chunk *chunkB = (const Chunk*) b;
+
+	if (chunkA->orderKey < chunkB->orderKey)
+	{
+		return -1;
+	}
+
+	return chunkA->orderKey > chunkB->orderKey;
+}
+
+/* Chunk slots */
+
+uint32_t Wellspring_GetTextBatchChunkCount(
+	Wellspring_TextBatch *textBatch
+) {
+	return ((Batch*) textBatch)->chunkCount;
+}
+
+/* Collapses the vertices to a point so they rasterize nothing */
+static void Wellspring_INTERNAL_DegenerateVertices(Batch *batch, uint32_t firstVertex, uint32_t vertexCount)
+{
+	Wellspring_Vertex *vertex;
+	uint32_t i;
+
+	for (i = 0; i < vertexCount; i += 1)
+	{
+		vertex = Wellspring_INTERNAL_GetVertex(batch, firstVertex + i);
+		vertex->x = 0;
+		vertex->y = 0;
+	}
+
+	Wellspring_INTERNAL_MarkDirty(batch, firstVertex, vertexCount);
+}
+
+static void Wellspring_INTERNAL_PushFreeRange(Batch *batch, uint32_t firstVertex, uint32_t vertexCount)
+{
+	if (batch->freeRangeCount == batch->freeRangeCapacity)
+	{
+		batch->freeRangeCapacity = batch->freeRangeCapacity == 0 ? 16 : batch->freeRangeCapacity * 2;
+		batch->freeRanges = Wellspring_realloc(batch->freeRanges, sizeof(Wellspring_VertexRange) * batch->freeRangeCapacity);
+	}
+
+	batch->freeRanges[batch->freeRangeCount].firstVertex = firstVertex;
+	batch->freeRanges[batch->freeRangeCount].vertexCount = vertexCount;
+	batch->freeRangeCount += 1;
+}
+
+static void Wellspring_INTERNAL_FreeSlot(Batch *batch, uint32_t firstVertex, uint32_t vertexCount)
+{
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	if (firstVertex + vertexCount == batch->vertexCount)
+	{
+		/* Slot at the end, just give it back */
+		batch->vertexCount = firstVertex;
+		return;
+	}
+
+	Wellspring_INTERNAL_DegenerateVertices(batch, firstVertex, vertexCount);
+	Wellspring_INTERNAL_PushFreeRange(batch, firstVertex, vertexCount);
+}
+
+/* Moves vertices towards the start of the batch, src ranges may overlap dst */
+static void Wellspring_INTERNAL_MoveVerticesDown(Batch *batch, uint32_t dstVertex, uint32_t srcVertex, uint32_t vertexCount)
+{
+	uint32_t moved, run;
+
+	for (moved = 0; moved < vertexCount; moved += run)
+	{
+		run = vertexCount - moved;
+		if (batch->verticesPerSegment != 0)
+		{
+			run = Wellspring_min(run, batch->verticesPerSegment - (dstVertex + moved) % batch->verticesPerSegment);
+			run = Wellspring_min(run, batch->verticesPerSegment - (srcVertex + moved) % batch->verticesPerSegment);
+		}
+
+		Wellspring_memmove(
+			Wellspring_INTERNAL_GetVertex(batch, dstVertex + moved),
+			Wellspring_INTERNAL_GetVertex(batch, srcVertex + moved),
+			sizeof(Wellspring_Vertex) * run
+		);
+	}
+}
+
+uint8_t Wellspring_ReplaceChunk(
+	Wellspring_TextBatch *textBatch,
+	uint32_t chunkIndex,
+	Wellspring_Font *font,
+	int pixelSize,
+	Wellspring_HorizontalAlignment horizontalAlignment,
+	Wellspring_VerticalAlignment verticalAlignment,
+	const uint8_t *strBytes,
+	uint32_t strLengthInBytes,
+	const Wellspring_Transform *transform
+) {
+	Batch *batch = (Batch*) textBatch;
+	Font *currentFont = (Font*) font;
+	Chunk *chunk;
+	Wellspring_VertexRange *freeRange;
+	Wellspring_TextBatchStats layoutStats = { 0 };
+	Text text = Wellspring_INTERNAL_MakeText(strBytes, strLengthInBytes, TEXT_ENCODING_UTF8);
+	uint32_t layoutVertex = batch->vertexCount;
+	uint32_t vertexCount, i;
+
+	if (chunkIndex >= batch->chunkCount || batch->chunks[chunkIndex].removed)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid chunk index %u!", chunkIndex);
+		return 0;
+	}
+
+	/* Lay out at the end of the batch, then move into a slot that fits */
+	if (!Wellspring_INTERNAL_LayoutChunk(
+		batch,
+		currentFont,
+		pixelSize,
+		horizontalAlignment,
+		verticalAlignment,
+		&text,
+		transform,
+		chunkIndex,
+		NULL,
+		&layoutStats
+	)) {
+		/* Whatever was emitted before the error has been discarded */
+		Wellspring_StatAdd(batch->stats.utf8Rejects, 1);
+		return 0;
+	}
+
+	Wellspring_INTERNAL_MergeStats(batch, &layoutStats, 0);
+	Wellspring_INTERNAL_CountLayoutCall(currentFont);
+
+	chunk = &batch->chunks[chunkIndex];
+	vertexCount = batch->vertexCount - layoutVertex;
+	batch->vertexCount = layoutVertex;
+
+	/* The layout wrote over vertices that chunks retained past this point still claim */
+	batch->retainedChunkCount = Wellspring_min(batch->retainedChunkCount, batch->chunkCount);
+
+	chunk->atlasID = currentFont->atlasID;
+	chunk->multiPage = currentFont->packer.pageCount > 1;
+	chunk->hash = batch->retained ?
+		Wellspring_INTERNAL_HashChunk(currentFont, pixelSize, horizontalAlignment, verticalAlignment, &text, transform) :
+		0;
+
+	if (vertexCount <= chunk->vertexCapacity)
+	{
+		/* Fits in the current slot, degenerate whatever is left over */
+		Wellspring_INTERNAL_MoveVerticesDown(batch, chunk->firstVertex, layoutVertex, vertexCount);
+		chunk->vertexCount = vertexCount;
+
+		Wellspring_INTERNAL_MarkDirty(batch, chunk->firstVertex, vertexCount);
+		Wellspring_INTERNAL_DegenerateVertices(batch, chunk->firstVertex + vertexCount, chunk->vertexCapacity - vertexCount);
+		return 1;
+	}
+
+	Wellspring_INTERNAL_FreeSlot(batch, chunk->firstVertex, chunk->vertexCapacity);
+	chunk->vertexCount = vertexCount;
+	chunk->vertexCapacity = vertexCount;
+
+	for (i = 0; i < batch->freeRangeCount; i += 1)
+	{
+		freeRange = &batch->freeRanges[i];
+
+		if (freeRange->vertexCount >= vertexCount)
+		{
+			Wellspring_INTERNAL_MoveVerticesDown(batch, freeRange->firstVertex, layoutVertex, vertexCount);
+
+			chunk->firstVertex = freeRange->firstVertex;
+			freeRange->firstVertex += vertexCount;
+			freeRange->vertexCount -= vertexCount;
+			if (freeRange->vertexCount == 0)
+			{
+				batch->freeRanges[i] = batch->freeRanges[batch->freeRangeCount - 1];
+				batch->freeRangeCount -= 1;
+			}
+
+			Wellspring_INTERNAL_MarkDirty(batch, chunk->firstVertex, vertexCount);
+			return 1;
+		}
+	}
+
+	/* No free slot is big enough, append it. If the old slot was at the end this slides into it. */
+	if (batch->vertexCount != layoutVertex)
+	{
+		Wellspring_INTERNAL_MoveVerticesDown(batch, batch->vertexCount, layoutVertex, vertexCount);
+	}
+
+	chunk->firstVertex = batch->vertexCount;
+	batch->vertexCount += vertexCount;
+	Wellspring_INTERNAL_MarkDirty(batch, chunk->firstVertex, vertexCount);
+	return 1;
+}
+
+void Wellspring_RemoveChunk(
+	Wellspring_TextBatch *textBatch,
+	uint32_t chunkIndex
+) {
+	Batch *batch = (Batch*) textBatch;
+	Chunk *chunk;
+
+	if (chunkIndex >= batch->chunkCount || batch->chunks[chunkIndex].removed)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid chunk index %u!", chunkIndex);
+		return;
+	}
+
+	chunk = &batch->chunks[chunkIndex];
+	Wellspring_INTERNAL_FreeSlot(batch, chunk->firstVertex, chunk->vertexCapacity);
+
+	chunk->vertexCount = 0;
+	chunk->vertexCapacity = 0;
+	chunk->removed = 1;
+}
+
+static int Wellspring_INTERNAL_CompareChunkPosition(const void *a, const void *b)
+{
+	const Chunk *chunkA = *(const Chunk**) a;
+	const Chunk *chunkB = *(const Chunk**) b;
+
+	if (chunkA->firstVertex < chunkB->firstVertex)
+	{
+		return -1;
+	}
+
+	return chunkA->firstVertex > chunkB->firstVertex;
+}
+
+void Wellspring_CompactTextBatch(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pMoveCount,
+	Wellspring_VertexMove **pMoves
+) {
+	Batch *batch = (Batch*) textBatch;
+	Wellspring_VertexMove *move;
+	Chunk *chunk;
+	uint32_t liveCount = 0, cursor = 0, i;
+
+	batch->moveCount = 0;
+
+	if (batch->compactOrderCapacity < batch->chunkCount)
+	{
+		batch->compactOrderCapacity = batch->chunkCapacity;
+		batch->compactOrder = Wellspring_realloc(batch->compactOrder, sizeof(Chunk*) * batch->compactOrderCapacity);
+	}
+
+	for (i = 0; i < batch->chunkCount; i += 1)
+	{
+		if (batch->chunks[i].vertexCapacity > 0)
+		{
+			batch->compactOrder[liveCount] = &batch->chunks[i];
+			liveCount += 1;
+		}
+	}
+
+	Wellspring_sort(batch->compactOrder, liveCount, sizeof(Chunk*), Wellspring_INTERNAL_CompareChunkPosition);
+
+	/* Slide every chunk down over the holes in buffer order, dropping slot slack */
+	for (i = 0; i < liveCount; i += 1)
+	{
+		chunk = batch->compactOrder[i];
+
+		if (chunk->firstVertex != cursor && chunk->vertexCount > 0)
+		{
+			Wellspring_INTERNAL_MoveVerticesDown(batch, cursor, chunk->firstVertex, chunk->vertexCount);
+
+			move = batch->moveCount > 0 ? &batch->moves[batch->moveCount - 1] : NULL;
+			if (
+				move != NULL &&
+				move->srcFirstVertex + move->vertexCount == chunk->firstVertex &&
+				move->dstFirstVertex + move->vertexCount == cursor
+			) {
+				move->vertexCount += chunk->vertexCount;
+			}
+			else
+			{
+				if (batch->moveCount == batch->moveCapacity)
+				{
+					batch->moveCapacity = batch->moveCapacity == 0 ? 16 : batch->moveCapacity * 2;
+					batch->moves = Wellspring_realloc(batch->moves, sizeof(Wellspring_VertexMove) * batch->moveCapacity);
+				}
+
+				move = &batch->moves[batch->moveCount];
+				move->srcFirstVertex = chunk->firstVertex;
+				move->dstFirstVertex = cursor;
+				move->vertexCount = chunk->vertexCount;
+				batch->moveCount += 1;
+			}
+
+			Wellspring_INTERNAL_MarkDirty(batch, cursor, chunk->vertexCount);
+		}
+
+		chunk->firstVertex = cursor;
+		chunk->vertexCapacity = chunk->vertexCount;
+		cursor += chunk->vertexCount;
+	}
+
+	batch->vertexCount = cursor;
+	batch->freeRangeCount = 0;
+
+	*pMoveCount = batch->moveCount;
+	*pMoves = batch->moves;
+}
+
+/* Merging */
+
+/* Copies vertices from one batch to another, offsetting their chunk indices */
+static void Wellspring_INTERNAL_CopyVerticesRemapped(
+	Batch *dstBatch,
+	uint32_t dstVertex,
+	Batch *srcBatch,
+	uint32_t srcVertex,
+	uint32_t vertexCount,
+	uint32_t chunkOffset
+) {
+	Wellspring_Vertex *dst, *src;
+	uint32_t copied, run, i;
+
+	for (copied = 0; copied < vertexCount; copied += run)
+	{
+		run = vertexCount - copied;
+		if (dstBatch->verticesPerSegment != 0)
+		{
+			run = Wellspring_min(run, dstBatch->verticesPerSegment - (dstVertex + copied) % dstBatch->verticesPerSegment);
+		}
+		if (srcBatch->verticesPerSegment != 0)
+		{
+			run = Wellspring_min(run, srcBatch->verticesPerSegment - (srcVertex + copied) % srcBatch->verticesPerSegment);
+		}
+
+		dst = Wellspring_INTERNAL_GetVertex(dstBatch, dstVertex + copied);
+		src = Wellspring_INTERNAL_GetVertex(srcBatch, srcVertex + copied);
+
+		for (i = 0; i < run; i += 1)
+		{
+			dst[i] = src[i];
+			dst[i].chunkIndex += chunkOffset;
+		}
+	}
+}
+
+void Wellspring_MergeTextBatches(
+	Wellspring_TextBatch *textBatch,
+	Wellspring_TextBatch **sourceTextBatches,
+	uint32_t sourceTextBatchCount
+) {
+	Batch *batch = (Batch*) textBatch;
+	Batch *source;
+	Chunk *chunk;
+	uint32_t totalVertexCount = batch->vertexCount;
+	uint32_t vertexOffset, chunkOffset, i, j;
+
+	for (i = 0; i < sourceTextBatchCount; i += 1)
+	{
+		/* Appending to the batch that is being read would never finish */
+		if (sourceTextBatches[i] == textBatch)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Can't merge a batch into itself!");
+			return;
+		}
+
+		totalVertexCount += ((Batch*) sourceTextBatches[i])->vertexCount;
+	}
+
+	Wellspring_INTERNAL_ReserveVertices(batch, totalVertexCount);
+
+	for (i = 0; i < sourceTextBatchCount; i += 1)
+	{
+		source = (Batch*) sourceTextBatches[i];
+		vertexOffset = batch->vertexCount;
+		chunkOffset = batch->chunkCount;
+
+		Wellspring_INTERNAL_CopyVerticesRemapped(batch, vertexOffset, source, 0, source->vertexCount, chunkOffset);
+		batch->vertexCount += source->vertexCount;
+
+		for (j = 0; j < source->chunkCount; j += 1)
+		{
+			chunk = Wellspring_INTERNAL_PushChunk(batch);
+			*chunk = source->chunks[j];
+			chunk->firstVertex += vertexOffset;
+		}
+
+		for (j = 0; j < source->freeRangeCount; j += 1)
+		{
+			Wellspring_INTERNAL_PushFreeRange(
+				batch,
+				source->freeRanges[j].firstVertex + vertexOffset,
+				source->freeRanges[j].vertexCount
+			);
+		}
 
-		previousGlyphIndex = glyphIndex;
+		Wellspring_INTERNAL_MarkDirty(batch, vertexOffset, source->vertexCount);
 	}
+}
 
-	batch->chunkCount += 1;
+static uint32_t Wellspring_INTERNAL_PushDrawRange(Batch *batch, uint32_t atlasID, uint32_t page, uint32_t firstVertex)
+{
+	if (batch->drawRangeCount == batch->drawRangeCapacity)
+	{
+		batch->drawRangeCapacity = batch->drawRangeCapacity == 0 ? 4 : batch->drawRangeCapacity * 2;
+		batch->drawRanges = Wellspring_realloc(batch->drawRanges, sizeof(Wellspring_DrawRange) * batch->drawRangeCapacity);
+	}
 
-	return 1;
+	batch->drawRanges[batch->drawRangeCount].atlasID = atlasID;
+	batch->drawRanges[batch->drawRangeCount].page = page;
+	batch->drawRanges[batch->drawRangeCount].firstVertex = firstVertex;
+	batch->drawRanges[batch->drawRangeCount].vertexCount = 0;
+	batch->drawRangeCount += 1;
+
+	return batch->drawRangeCount - 1;
+}
+
+static uint32_t Wellspring_INTERNAL_FindDrawRange(Batch *batch, uint32_t atlasID, uint32_t page, uint32_t hint)
+{
+	uint32_t i;
+
+	if (hint < batch->drawRangeCount && batch->drawRanges[hint].atlasID == atlasID && batch->drawRanges[hint].page == page)
+	{
+		return hint;
+	}
+
+	for (i = 0; i < batch->drawRangeCount; i += 1)
+	{
+		if (batch->drawRanges[i].atlasID == atlasID && batch->drawRanges[i].page == page)
+		{
+			return i;
+		}
+	}
+
+	return Wellspring_INTERNAL_PushDrawRange(batch, atlasID, page, 0);
+}
+
+/* Retained batches: vertices stay put, so a range only grows if the vertices follow on from it */
+static void Wellspring_INTERNAL_ExtendDrawRange(Batch *batch, uint32_t atlasID, uint32_t page, uint32_t firstVertex, uint32_t vertexCount)
+{
+	Wellspring_DrawRange *range = batch->drawRangeCount > 0 ? &batch->drawRanges[batch->drawRangeCount - 1] : NULL;
+	uint32_t rangeIndex;
+
+	if (
+		range == NULL ||
+		range->atlasID != atlasID ||
+		range->page != page ||
+		range->firstVertex + range->vertexCount != firstVertex
+	) {
+		/* Pushing can move the ranges */
+		rangeIndex = Wellspring_INTERNAL_PushDrawRange(batch, atlasID, page, firstVertex);
+		range = &batch->drawRanges[rangeIndex];
+	}
+
+	range->vertexCount += vertexCount;
+}
+
+static void Wellspring_INTERNAL_EnsureGatherCapacity(Batch *batch)
+{
+	if (batch->gatherCapacity < batch->vertexCount)
+	{
+		Wellspring_aligned_free(batch->gatherVertices);
+		batch->gatherCapacity = batch->vertexCapacity;
+		batch->gatherVertices = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * batch->gatherCapacity);
+	}
+}
+
+/* Copies vertices between batch storage and a contiguous buffer, across segments if needed */
+static inline void Wellspring_INTERNAL_ReadVertices(Batch *batch, uint32_t firstVertex, uint32_t count, Wellspring_Vertex *dst)
+{
+	uint32_t copied, run;
+
+	for (copied = 0; copied < count; copied += run)
+	{
+		run = count - copied;
+		if (batch->verticesPerSegment != 0)
+		{
+			run = Wellspring_min(run, batch->verticesPerSegment - (firstVertex + copied) % batch->verticesPerSegment);
+		}
+
+		Wellspring_memcpy(dst + copied, Wellspring_INTERNAL_GetVertex(batch, firstVertex + copied), sizeof(Wellspring_Vertex) * run);
+	}
+}
+
+static inline void Wellspring_INTERNAL_WriteVertices(Batch *batch, uint32_t firstVertex, uint32_t count, const Wellspring_Vertex *src)
+{
+	uint32_t copied, run;
+
+	for (copied = 0; copied < count; copied += run)
+	{
+		run = count - copied;
+		if (batch->verticesPerSegment != 0)
+		{
+			run = Wellspring_min(run, batch->verticesPerSegment - (firstVertex + copied) % batch->verticesPerSegment);
+		}
+
+		Wellspring_memcpy(Wellspring_INTERNAL_GetVertex(batch, firstVertex + copied), src + copied, sizeof(Wellspring_Vertex) * run);
+	}
+}
+
+/* Moves concurrently added chunks into orderKey order, as if they had been added serially in that order */
+static void Wellspring_INTERNAL_ResolveConcurrentChunks(Batch *batch)
+{
+	uint32_t chunkCount = (uint32_t) SDL_GetAtomicInt(&batch->concurrentChunkCount);
+	uint32_t vertexCount = (uint32_t) SDL_GetAtomicInt(&batch->concurrentVertexCount);
+	uint32_t firstChunk = batch->chunkCount;
+	uint32_t firstVertex = batch->vertexCount;
+	uint32_t vertexCursor = firstVertex;
+	uint32_t i, j;
+	Wellspring_Vertex *vertices;
+	Chunk *chunk;
+
+	if (chunkCount == 0)
+	{
+		return;
+	}
+
+	SDL_SetAtomicInt(&batch->concurrentChunkCount, 0);
+	SDL_SetAtomicInt(&batch->concurrentVertexCount, 0);
+	batch->chunkCount += chunkCount;
+	batch->vertexCount += vertexCount;
+
+	/* Arrival order depends on thread timing, the order keys don't */
+	Wellspring_sort(batch->chunks + firstChunk, chunkCount, sizeof(Chunk), Wellspring_INTERNAL_CompareChunkOrder);
+
+	Wellspring_INTERNAL_EnsureGatherCapacity(batch);
+
+	for (i = 0; i < chunkCount; i += 1)
+	{
+		chunk = &batch->chunks[firstChunk + i];
+		vertices = batch->gatherVertices + vertexCursor;
+
+		Wellspring_INTERNAL_ReadVertices(batch, chunk->firstVertex, chunk->vertexCount, vertices);
+		for (j = 0; j < chunk->vertexCount; j += 1)
+		{
+			vertices[j].chunkIndex = firstChunk + i;
+		}
+
+		chunk->firstVertex = vertexCursor;
+		vertexCursor += chunk->vertexCount;
+	}
+
+	Wellspring_INTERNAL_WriteVertices(batch, firstVertex, vertexCount, batch->gatherVertices + firstVertex);
+	Wellspring_INTERNAL_MarkDirty(batch, firstVertex, vertexCount);
+}
+
+/* Ranges for a chunk whose vertices are already in draw order.
+ * Chunks of multi-page fonts get one per run of quads on the same page.
+ */
+static void Wellspring_INTERNAL_AppendChunkRanges(Batch *batch, const Chunk *chunk)
+{
+	uint32_t quad, page;
+
+	if (!chunk->multiPage)
+	{
+		Wellspring_INTERNAL_ExtendDrawRange(batch, chunk->atlasID, 0, chunk->firstVertex, chunk->vertexCount);
+		return;
+	}
+
+	for (quad = chunk->firstVertex; quad < chunk->firstVertex + chunk->vertexCount; quad += 4)
+	{
+		page = Wellspring_INTERNAL_GetVertex(batch, quad)->page;
+		Wellspring_INTERNAL_ExtendDrawRange(batch, chunk->atlasID, page, quad, 4);
+	}
+}
+
+/* Copies a multi-page chunk's quads to dst grouped by page, in page order.
+ * Quads keep their order within a page. Chunks rarely span more than a few
+ * pages, so each page is a pass over the chunk.
+ */
+static void Wellspring_INTERNAL_GatherByPage(Batch *batch, const Chunk *chunk, Wellspring_Vertex *dst)
+{
+	uint32_t page = 0, nextPage, quadPage, quad, written = 0;
+
+	while (written < chunk->vertexCount)
+	{
+		nextPage = UINT32_MAX;
+
+		for (quad = chunk->firstVertex; quad < chunk->firstVertex + chunk->vertexCount; quad += 4)
+		{
+			quadPage = Wellspring_INTERNAL_GetVertex(batch, quad)->page;
+
+			if (quadPage == page)
+			{
+				Wellspring_INTERNAL_ReadVertices(batch, quad, 4, dst + written);
+				written += 4;
+			}
+			else if (quadPage > page && quadPage < nextPage)
+			{
+				nextPage = quadPage;
+			}
+		}
+
+		page = nextPage;
+	}
+}
+
+static void Wellspring_INTERNAL_FinalizeTextBatch(Batch *batch)
+{
+	Wellspring_Vertex *sorted;
+	uint32_t i, rangeIndex = 0, firstVertex = 0, packedCount = 0, multiPageCount = 0;
+	Chunk *chunk;
+
+	Wellspring_INTERNAL_ResolveConcurrentChunks(batch);
+
+	batch->drawRangeCount = 0;
+
+	if (batch->retained)
+	{
+		/* Sorting would move unchanged vertices, so only chunks that are adjacent in the buffer are merged */
+		for (i = 0; i < batch->chunkCount; i += 1)
+		{
+			if (batch->chunks[i].vertexCount > 0)
+			{
+				Wellspring_INTERNAL_AppendChunkRanges(batch, &batch->chunks[i]);
+			}
+		}
+		return;
+	}
+
+	/* Count vertices per atlas, ranges are ordered by first appearance.
+	 * Removed chunks, free ranges and slot slack are not counted, so they get packed out.
+	 */
+	for (i = 0; i < batch->chunkCount; i += 1)
+	{
+		chunk = &batch->chunks[i];
+		packedCount += chunk->vertexCount;
+
+		if (chunk->vertexCount == 0)
+		{
+			continue;
+		}
+
+		multiPageCount += chunk->multiPage;
+		rangeIndex = Wellspring_INTERNAL_FindDrawRange(batch, chunk->atlasID, 0, rangeIndex);
+		batch->drawRanges[rangeIndex].vertexCount += chunk->vertexCount;
+	}
+
+	if (batch->drawRangeCount <= 1 && packedCount == batch->vertexCount && multiPageCount == 0)
+	{
+		/* Already grouped and packed */
+		batch->freeRangeCount = 0;
+		return;
+	}
+
+	for (i = 0; i < batch->drawRangeCount; i += 1)
+	{
+		batch->drawRanges[i].firstVertex = firstVertex;
+		firstVertex += batch->drawRanges[i].vertexCount;
+	}
+
+	/* Stable bucket sort of the chunk ranges, using the range starts as cursors.
+	 * Chunks stay contiguous, so their slots can still be replaced and removed.
+	 */
+	Wellspring_INTERNAL_EnsureGatherCapacity(batch);
+	sorted = batch->gatherVertices;
+
+	for (i = 0; i < batch->chunkCount; i += 1)
+	{
+		chunk = &batch->chunks[i];
+		chunk->vertexCapacity = chunk->vertexCount;
+
+		if (chunk->vertexCount == 0)
+		{
+			chunk->firstVertex = 0;
+			continue;
+		}
+
+		rangeIndex = Wellspring_INTERNAL_FindDrawRange(batch, chunk->atlasID, 0, rangeIndex);
+		firstVertex = batch->drawRanges[rangeIndex].firstVertex;
+
+		if (chunk->multiPage)
+		{
+			Wellspring_INTERNAL_GatherByPage(batch, chunk, sorted + firstVertex);
+		}
+		else
+		{
+			Wellspring_INTERNAL_ReadVertices(batch, chunk->firstVertex, chunk->vertexCount, sorted + firstVertex);
+		}
+
+		chunk->firstVertex = firstVertex;
+		batch->drawRanges[rangeIndex].firstVertex += chunk->vertexCount;
+	}
+
+	for (i = 0; i < batch->drawRangeCount; i += 1)
+	{
+		batch->drawRanges[i].firstVertex -= batch->drawRanges[i].vertexCount;
+	}
+
+	if (batch->verticesPerSegment == 0)
+	{
+		/* Swap storage with the scratch buffer instead of copying back */
+		batch->gatherVertices = batch->vertices;
+		batch->vertices = sorted;
+		i = batch->gatherCapacity;
+		batch->gatherCapacity = batch->vertexCapacity;
+		batch->vertexCapacity = i;
+	}
+	else
+	{
+		Wellspring_INTERNAL_WriteVertices(batch, 0, packedCount, sorted);
+	}
+
+	batch->vertexCount = packedCount;
+	batch->freeRangeCount = 0;
+
+	/* Everything may have moved */
+	batch->dirtyRangeCount = 0;
+	Wellspring_INTERNAL_MarkDirty(batch, 0, packedCount);
+	/* Multi-page chunks split their atlas range into a range per page run */
+	if (multiPageCount > 0)
+	{
+		batch->drawRangeCount = 0;
+
+		for (firstVertex = 0; firstVertex < packedCount; firstVertex += chunk->vertexCount)
+		{
+			chunk = &batch->chunks[Wellspring_INTERNAL_GetVertex(batch, firstVertex)->chunkIndex];
+			Wellspring_assert(chunk->firstVertex == firstVertex);
+			Wellspring_INTERNAL_AppendChunkRanges(batch, chunk);
+		}
+	}
+}
+
+void Wellspring_FinalizeTextBatch(
+	Wellspring_TextBatch *textBatch
+) {
+	Batch *batch = (Batch*) textBatch;
+
+	Wellspring_INTERNAL_BeginZone(ZONE_FINALIZE);
+	Wellspring_INTERNAL_FinalizeTextBatch(batch);
+	Wellspring_INTERNAL_EndZone(ZONE_FINALIZE);
+
+	Wellspring_INTERNAL_Plot(PLOT_BATCH_VERTICES, batch->vertexCount);
+}
+
+void Wellspring_GetDrawRanges(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pDrawRangeCount,
+	Wellspring_DrawRange **pDrawRanges
+) {
+	Batch *batch = (Batch*) textBatch;
+	*pDrawRangeCount = batch->drawRangeCount;
+	*pDrawRanges = batch->drawRanges;
+}
+
+void Wellspring_GetDirtyRanges(
+	Wellspring_TextBatch *textBatch,
+	uint32_t *pDirtyRangeCount,
+	Wellspring_VertexRange **pDirtyRanges
+) {
+	Batch *batch = (Batch*) textBatch;
+	*pDirtyRangeCount = batch->dirtyRangeCount;
+	*pDirtyRanges = batch->dirtyRanges;
 }
 
 void Wellspring_GetBufferData(
@@ -901,26 +5437,213 @@ void Wellspring_GetBufferData(
 	Wellspring_Vertex **pVertexBuffer
 ) {
 	Batch *batch = (Batch*) textBatch;
+
 	*pVertexCount = batch->vertexCount;
-	*pVertexBuffer = batch->vertices;
+
+	if (batch->verticesPerSegment == 0 || batch->vertexCount <= batch->verticesPerSegment)
+	{
+		*pVertexBuffer = Wellspring_INTERNAL_GetVertex(batch, 0);
+		return;
+	}
+
+	/* Segmented batches spanning several segments have to be gathered */
+	Wellspring_INTERNAL_EnsureGatherCapacity(batch);
+	Wellspring_INTERNAL_ReadVertices(batch, 0, batch->vertexCount, batch->gatherVertices);
+
+	*pVertexBuffer = batch->gatherVertices;
+}
+
+uint32_t Wellspring_GetBufferSegmentCount(
+	Wellspring_TextBatch *textBatch
+) {
+	Batch *batch = (Batch*) textBatch;
+
+	if (batch->verticesPerSegment == 0)
+	{
+		return batch->vertexCount > 0 ? 1 : 0;
+	}
+
+	return (batch->vertexCount + batch->verticesPerSegment - 1) / batch->verticesPerSegment;
+}
+
+void Wellspring_GetBufferSegment(
+	Wellspring_TextBatch *textBatch,
+	uint32_t segmentIndex,
+	uint32_t *pVertexCount,
+	Wellspring_Vertex **pVertexBuffer
+) {
+	Batch *batch = (Batch*) textBatch;
+
+	if (batch->verticesPerSegment == 0)
+	{
+		*pVertexCount = batch->vertexCount;
+		*pVertexBuffer = batch->vertices;
+		return;
+	}
+
+	*pVertexCount = Wellspring_min(batch->verticesPerSegment, batch->vertexCount - segmentIndex * batch->verticesPerSegment);
+	*pVertexBuffer = batch->segments[segmentIndex];
 }
 
 void Wellspring_DestroyTextBatch(Wellspring_TextBatch *textBatch)
 {
 	Batch *batch = (Batch*) textBatch;
-	Wellspring_free(batch->vertices);
+	uint32_t i;
+
+	for (i = 0; i < batch->segmentCount; i += 1)
+	{
+		Wellspring_aligned_free(batch->segments[i]);
+	}
+
+	Wellspring_free(batch->segments);
+	Wellspring_free(batch->chunks);
+	Wellspring_free(batch->drawRanges);
+	Wellspring_free(batch->dirtyRanges);
+	Wellspring_free(batch->freeRanges);
+	Wellspring_free(batch->compactOrder);
+	Wellspring_free(batch->moves);
+	Wellspring_free(batch->parallelChunks);
+	Wellspring_aligned_free(batch->gatherVertices);
+	SDL_DestroyRWLock(batch->growLock);
+	Wellspring_aligned_free(batch->vertices);
 	Wellspring_free(batch);
 }
 
+/* Batch rings */
+
+Wellspring_TextBatchRing* Wellspring_CreateTextBatchRing(uint32_t framesInFlight)
+{
+	BatchRing *ring = Wellspring_malloc(sizeof(BatchRing));
+	uint32_t i;
+
+	Wellspring_memset(ring, 0, sizeof(BatchRing));
+
+	if (framesInFlight == 0)
+	{
+		framesInFlight = 1;
+	}
+
+	ring->batchCount = framesInFlight;
+	ring->batches = Wellspring_malloc(sizeof(Batch*) * framesInFlight);
+
+	for (i = 0; i < framesInFlight; i += 1)
+	{
+		ring->batches[i] = (Batch*) Wellspring_CreateTextBatch();
+	}
+
+	return (Wellspring_TextBatchRing*) ring;
+}
+
+Wellspring_TextBatch* Wellspring_AcquireTextBatch(Wellspring_TextBatchRing *textBatchRing)
+{
+	BatchRing *ring = (BatchRing*) textBatchRing;
+	Batch *batch;
+
+	if (ring->inFlightCount == ring->batchCount)
+	{
+		/* Every frame is still in flight, the caller has to retire one first. */
+		return NULL;
+	}
+
+	batch = ring->batches[ring->nextBatch];
+	ring->nextBatch = (ring->nextBatch + 1) % ring->batchCount;
+	ring->inFlightCount += 1;
+
+	Wellspring_StartTextBatch((Wellspring_TextBatch*) batch);
+	Wellspring_INTERNAL_ReserveVertices(batch, ring->peakVertexCount);
+
+	return (Wellspring_TextBatch*) batch;
+}
+
+void Wellspring_RetireTextBatch(Wellspring_TextBatchRing *textBatchRing)
+{
+	BatchRing *ring = (BatchRing*) textBatchRing;
+	Batch *batch;
+	uint32_t i, windowSize;
+
+	if (ring->inFlightCount == 0)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "No text batch in flight to retire!");
+		return;
+	}
+
+	/* The oldest batch in flight */
+	batch = ring->batches[(ring->nextBatch + ring->batchCount - ring->inFlightCount) % ring->batchCount];
+	ring->inFlightCount -= 1;
+
+	ring->retiredVertexCounts[ring->retiredFrameCount % RING_PEAK_WINDOW] = batch->vertexCount;
+	ring->retiredFrameCount += 1;
+
+	windowSize = Wellspring_min(ring->retiredFrameCount, RING_PEAK_WINDOW);
+	ring->peakVertexCount = 0;
+	for (i = 0; i < windowSize; i += 1)
+	{
+		if (ring->retiredVertexCounts[i] > ring->peakVertexCount)
+		{
+			ring->peakVertexCount = ring->retiredVertexCounts[i];
+		}
+	}
+
+	/* Storage left over from an old spike goes back once it falls out of the window */
+	Wellspring_StartTextBatch((Wellspring_TextBatch*) batch);
+	if (batch->vertexCapacity > ring->peakVertexCount * 2 && batch->vertexCapacity > INITIAL_QUAD_CAPACITY * 4)
+	{
+		Wellspring_INTERNAL_TrimVertices(batch, Wellspring_max(ring->peakVertexCount, INITIAL_QUAD_CAPACITY * 4));
+	}
+}
+
+void Wellspring_DestroyTextBatchRing(Wellspring_TextBatchRing *textBatchRing)
+{
+	BatchRing *ring = (BatchRing*) textBatchRing;
+	uint32_t i;
+
+	for (i = 0; i < ring->batchCount; i += 1)
+	{
+		Wellspring_DestroyTextBatch((Wellspring_TextBatch*) ring->batches[i]);
+	}
+
+	Wellspring_free(ring->batches);
+	Wellspring_free(ring);
+}
+
 void Wellspring_DestroyFont(Wellspring_Font* font)
 {
 	Font *myFont = (Font*) font;
 
-	for (int i = 0; i < myFont->packer.rangeCount; i += 1)
+	if (!myFont->arena)
+	{
+		Wellspring_free(myFont->packer.metrics);
+		Wellspring_free(myFont->packer.ranges);
+		Wellspring_free(myFont->packer.pages);
+		Wellspring_free(myFont->kerning.pairs);
+	}
+
+	if (myFont->dynamic != NULL)
 	{
-		Wellspring_free(myFont->packer.ranges[i].data);
+		Wellspring_INTERNAL_DestroyDynamicGlyphs(myFont->dynamic);
 	}
-	Wellspring_free(myFont->packer.ranges);
-	Wellspring_free(myFont->fontBytes);
+
+	Wellspring_free(myFont->missingCodepoints);
 	Wellspring_free(myFont);
 }
+
+void Wellspring_DestroyPreparedText(Wellspring_PreparedText *preparedText)
+{
+	PreparedText *prepared = (PreparedText*) preparedText;
+
+	if (prepared == NULL)
+	{
+		return;
+	}
+
+	Wellspring_free(prepared->slots);
+	Wellspring_free(prepared);
+}
+
+void Wellspring_FreeAtlasImage(Wellspring_AtlasImage *image)
+{
+	Wellspring_free(image->pixels);
+	image->pixels = NULL;
+	image->width = 0;
+	image->height = 0;
+}
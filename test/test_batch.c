@@ -0,0 +1,562 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Randomized test of chunk handles and finalization.
+ *
+ * Usage: wellspring_test_batch [--rounds N] [--seed N]
+ *
+ * Adds, replaces, removes and compacts chunks of three fonts on different
+ * atlases, one of them split over two pages, finalizing at random points, and
+ * checks every finalized batch against a model: the draw ranges cover the whole
+ * buffer with no holes, every vertex belongs to a live chunk drawn with its own
+ * atlas and page, and every live chunk's vertices match the same text laid out
+ * alone. Replacements on a retained batch must not reuse stale vertices.
+ * Runs on contiguous and segmented batches.
+ */
+
+#include "Wellspring.h"
+#include "bench_fixture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FONT_COUNT 3
+#define MULTI_PAGE_FONT 2
+#define MAX_CHUNKS 64
+#define MAX_TEXT_LENGTH 16
+#define STEPS_PER_ROUND 48
+#define PIXEL_SIZE 16
+#define SEGMENT_VERTICES 24
+
+typedef struct ModelChunk
+{
+	char text[MAX_TEXT_LENGTH];
+	uint32_t length;
+	uint32_t font;
+	uint8_t live;
+} ModelChunk;
+
+static Wellspring_Font *fonts[FONT_COUNT];
+static Wellspring_TextBatch *referenceBatch;
+static ModelChunk model[MAX_CHUNKS];
+static Wellspring_Vertex references[MAX_CHUNKS][MAX_TEXT_LENGTH * 4];
+static uint32_t referenceCounts[MAX_CHUNKS];
+static uint32_t modelCount;
+static uint8_t retained; /* ranges may skip the unused tails of slots */
+static uint64_t rngState;
+
+static uint32_t NextRandom(void)
+{
+	/* xorshift64* */
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (uint32_t) ((rngState * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static void RandomText(ModelChunk *chunk)
+{
+	static const char alphabet[] = "abcdefghij ABCDEFGHIJ";
+	uint32_t i;
+
+	chunk->length = NextRandom() % MAX_TEXT_LENGTH;
+	for (i = 0; i < chunk->length; i += 1)
+	{
+		chunk->text[i] = alphabet[NextRandom() % (sizeof(alphabet) - 1)];
+	}
+	chunk->font = NextRandom() % FONT_COUNT;
+}
+
+static void SetText(ModelChunk *chunk, const char *text, uint32_t font)
+{
+	chunk->length = (uint32_t) strlen(text);
+	memcpy(chunk->text, text, chunk->length);
+	chunk->font = font;
+}
+
+static uint8_t Add(Wellspring_TextBatch *batch, ModelChunk *chunk)
+{
+	if (!Wellspring_AddChunkToTextBatch(
+		batch,
+		fonts[chunk->font],
+		PIXEL_SIZE,
+		WELLSPRING_HORIZONTALALIGNMENT_LEFT,
+		WELLSPRING_VERTICALALIGNMENT_BASELINE,
+		(const uint8_t*) chunk->text,
+		chunk->length
+	)) {
+		fprintf(stderr, "AddChunkToTextBatch failed\n");
+		return 0;
+	}
+
+	chunk->live = 1;
+	return 1;
+}
+
+static uint8_t Replace(Wellspring_TextBatch *batch, uint32_t chunkIndex)
+{
+	ModelChunk *chunk = &model[chunkIndex];
+
+	if (!Wellspring_ReplaceChunk(
+		batch,
+		chunkIndex,
+		fonts[chunk->font],
+		PIXEL_SIZE,
+		WELLSPRING_HORIZONTALALIGNMENT_LEFT,
+		WELLSPRING_VERTICALALIGNMENT_BASELINE,
+		(const uint8_t*) chunk->text,
+		chunk->length,
+		NULL
+	)) {
+		fprintf(stderr, "ReplaceChunk failed\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Lays out every live chunk alone, grouped by page, with chunkIndex patched in */
+static void BuildReferences(void)
+{
+	Wellspring_Vertex *vertices;
+	uint32_t i, j;
+
+	for (i = 0; i < modelCount; i += 1)
+	{
+		referenceCounts[i] = 0;
+		if (!model[i].live)
+		{
+			continue;
+		}
+
+		Wellspring_StartTextBatch(referenceBatch);
+		Add(referenceBatch, &model[i]);
+		Wellspring_FinalizeTextBatch(referenceBatch);
+		Wellspring_GetBufferData(referenceBatch, &referenceCounts[i], &vertices);
+
+		for (j = 0; j < referenceCounts[i]; j += 1)
+		{
+			references[i][j] = vertices[j];
+			references[i][j].chunkIndex = i;
+		}
+	}
+}
+
+static uint8_t Check(Wellspring_TextBatch *batch, const char *label)
+{
+	Wellspring_DrawRange *drawRanges;
+	Wellspring_Vertex *vertices, *segment;
+	uint32_t seen[MAX_CHUNKS];
+	uint32_t drawRangeCount, vertexCount, segmentVertexCount, count;
+	uint32_t i, j, chunkIndex;
+
+	Wellspring_FinalizeTextBatch(batch);
+	Wellspring_GetDrawRanges(batch, &drawRangeCount, &drawRanges);
+	Wellspring_GetBufferData(batch, &vertexCount, &vertices);
+
+	if (Wellspring_GetTextBatchChunkCount(batch) != modelCount)
+	{
+		fprintf(stderr, "%s: batch has %u chunks, expected %u\n", label, Wellspring_GetTextBatchChunkCount(batch), modelCount);
+		return 0;
+	}
+
+	segmentVertexCount = 0;
+	for (i = 0; i < Wellspring_GetBufferSegmentCount(batch); i += 1)
+	{
+		Wellspring_GetBufferSegment(batch, i, &count, &segment);
+		segmentVertexCount += count;
+	}
+
+	if (segmentVertexCount != vertexCount)
+	{
+		fprintf(stderr, "%s: segments hold %u vertices, buffer has %u\n", label, segmentVertexCount, vertexCount);
+		return 0;
+	}
+
+	/* Ranges tile the buffer in order */
+	j = 0;
+	for (i = 0; i < drawRangeCount; i += 1)
+	{
+		if (drawRanges[i].firstVertex < j || (!retained && drawRanges[i].firstVertex != j) || drawRanges[i].vertexCount == 0)
+		{
+			fprintf(stderr, "%s: draw range %u is %u+%u, expected to start at %u\n", label, i, drawRanges[i].firstVertex, drawRanges[i].vertexCount, j);
+			return 0;
+		}
+
+		for (j = drawRanges[i].firstVertex; j < drawRanges[i].firstVertex + drawRanges[i].vertexCount; j += 1)
+		{
+			chunkIndex = vertices[j].chunkIndex;
+
+			if (chunkIndex >= modelCount || !model[chunkIndex].live)
+			{
+				fprintf(stderr, "%s: vertex %u belongs to dead chunk %u\n", label, j, chunkIndex);
+				return 0;
+			}
+
+			if (Wellspring_GetFontAtlasID(fonts[model[chunkIndex].font]) != drawRanges[i].atlasID)
+			{
+				fprintf(stderr, "%s: vertex %u of chunk %u is in a range of atlas %u\n", label, j, chunkIndex, drawRanges[i].atlasID);
+				return 0;
+			}
+
+			if (vertices[j].page != drawRanges[i].page)
+			{
+				fprintf(stderr, "%s: vertex %u on page %u is in a range of page %u\n", label, j, vertices[j].page, drawRanges[i].page);
+				return 0;
+			}
+		}
+	}
+
+	if (retained ? j > vertexCount : j != vertexCount)
+	{
+		fprintf(stderr, "%s: draw ranges cover %u of %u vertices\n", label, j, vertexCount);
+		return 0;
+	}
+
+	/* Each chunk's vertices appear in order and match the text laid out alone */
+	BuildReferences();
+	memset(seen, 0, sizeof(seen));
+	for (i = 0; i < drawRangeCount; i += 1)
+	{
+		for (j = drawRanges[i].firstVertex; j < drawRanges[i].firstVertex + drawRanges[i].vertexCount; j += 1)
+		{
+			chunkIndex = vertices[j].chunkIndex;
+
+			if (seen[chunkIndex] >= referenceCounts[chunkIndex] || memcmp(&vertices[j], &references[chunkIndex][seen[chunkIndex]], sizeof(Wellspring_Vertex)) != 0)
+			{
+				fprintf(stderr, "%s: vertex %u doesn't match vertex %u of chunk %u\n", label, j, seen[chunkIndex], chunkIndex);
+				return 0;
+			}
+
+			seen[chunkIndex] += 1;
+		}
+	}
+
+	for (i = 0; i < modelCount; i += 1)
+	{
+		if (seen[i] != referenceCounts[i])
+		{
+			fprintf(stderr, "%s: chunk %u has %u vertices, expected %u\n", label, i, seen[i], referenceCounts[i]);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* The simplest holes: a removed chunk and a replacement that shrank in place */
+static uint8_t RunFixedCases(Wellspring_TextBatch *batch, uint32_t fontCount, const char *label)
+{
+	Wellspring_StartTextBatch(batch);
+	modelCount = 2;
+	SetText(&model[0], "ab", 0);
+	SetText(&model[1], "cd", fontCount - 1);
+	Add(batch, &model[0]);
+	Add(batch, &model[1]);
+	Wellspring_RemoveChunk(batch, 0);
+	model[0].live = 0;
+
+	if (!Check(batch, label))
+	{
+		return 0;
+	}
+
+	Wellspring_StartTextBatch(batch);
+	SetText(&model[0], "abcd", 0);
+	SetText(&model[1], "ef", fontCount - 1);
+	Add(batch, &model[0]);
+	Add(batch, &model[1]);
+	SetText(&model[0], "a", 0);
+	Replace(batch, 0);
+
+	if (!Check(batch, label))
+	{
+		return 0;
+	}
+
+	/* Free ranges from before the finalize must not be reused */
+	SetText(&model[1], "ghijk", fontCount - 1);
+	Replace(batch, 1);
+	SetText(&model[0], "ab", fontCount - 1);
+	Replace(batch, 0);
+
+	return Check(batch, label);
+}
+
+/* Slot operations on finalized multi-page chunks must only touch their own vertices */
+static uint8_t RunMultiPageCases(Wellspring_TextBatch *batch, const char *label)
+{
+	Wellspring_VertexMove *moves;
+	uint32_t moveCount;
+
+	Wellspring_StartTextBatch(batch);
+	modelCount = 3;
+	SetText(&model[0], "aAbB", MULTI_PAGE_FONT);
+	SetText(&model[1], "xY", MULTI_PAGE_FONT);
+	SetText(&model[2], "cd", 0);
+	Add(batch, &model[0]);
+	Add(batch, &model[1]);
+	Add(batch, &model[2]);
+
+	if (!Check(batch, label))
+	{
+		return 0;
+	}
+
+	SetText(&model[0], "zz", MULTI_PAGE_FONT);
+	Replace(batch, 0);
+
+	if (!Check(batch, label))
+	{
+		return 0;
+	}
+
+	SetText(&model[1], "CdEf", MULTI_PAGE_FONT);
+	Replace(batch, 1);
+	Wellspring_RemoveChunk(batch, 0);
+	model[0].live = 0;
+	Wellspring_CompactTextBatch(batch, &moveCount, &moves);
+
+	if (!Check(batch, label))
+	{
+		return 0;
+	}
+
+	Wellspring_RemoveChunk(batch, 1);
+	model[1].live = 0;
+
+	return Check(batch, label);
+}
+
+/* A replacement is laid out past the chunks re-added so far, over vertices that
+ * chunks retained from the last frame still claim
+ */
+static uint8_t RunRetainedCase(Wellspring_TextBatch *batch, const char *label)
+{
+	uint8_t result;
+
+	Wellspring_SetTextBatchRetained(batch, 1);
+	retained = 1;
+
+	Wellspring_StartTextBatch(batch);
+	modelCount = 2;
+	SetText(&model[0], "AAAA", 0);
+	SetText(&model[1], "BBBB", 0);
+	Add(batch, &model[0]);
+	Add(batch, &model[1]);
+
+	result = Check(batch, label);
+
+	if (result)
+	{
+		Wellspring_StartTextBatch(batch);
+		modelCount = 1;
+		Add(batch, &model[0]);
+		SetText(&model[0], "CC", 0);
+		Replace(batch, 0);
+		modelCount = 2;
+		Add(batch, &model[1]);
+
+		result = Check(batch, label);
+	}
+
+	Wellspring_SetTextBatchRetained(batch, 0);
+	retained = 0;
+	return result;
+}
+
+static uint8_t RunRound(Wellspring_TextBatch *batch, const char *label)
+{
+	Wellspring_VertexMove *moves;
+	uint32_t step, operation, chunkIndex, moveCount;
+
+	Wellspring_StartTextBatch(batch);
+	modelCount = 0;
+
+	for (step = 0; step < STEPS_PER_ROUND; step += 1)
+	{
+		operation = NextRandom() % 16;
+		chunkIndex = modelCount == 0 ? 0 : NextRandom() % modelCount;
+
+		if (modelCount == 0 || (operation < 6 && modelCount < MAX_CHUNKS))
+		{
+			RandomText(&model[modelCount]);
+			if (!Add(batch, &model[modelCount]))
+			{
+				return 0;
+			}
+			modelCount += 1;
+		}
+		else if (operation < 10 && model[chunkIndex].live)
+		{
+			RandomText(&model[chunkIndex]);
+			if (!Replace(batch, chunkIndex))
+			{
+				return 0;
+			}
+		}
+		else if (operation < 13 && model[chunkIndex].live)
+		{
+			Wellspring_RemoveChunk(batch, chunkIndex);
+			model[chunkIndex].live = 0;
+		}
+		else if (operation == 13)
+		{
+			Wellspring_CompactTextBatch(batch, &moveCount, &moves);
+		}
+		else if (operation >= 14 && !Check(batch, label))
+		{
+			return 0;
+		}
+	}
+
+	return Check(batch, label);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t codepoints[128], pageCodepoints[2][128], pageCodepointCounts[2];
+	BenchFixture fixture, pageFixtures[2];
+	const uint8_t *pageJsonBytes[2];
+	uint32_t pageJsonBytesLengths[2];
+	Wellspring_TextBatch *batches[2];
+	const char *labels[2] = { "contiguous", "segmented" };
+	uint32_t rounds = 2000;
+	uint32_t codepointCount = 0, i, j;
+	float pixelsPerEm, distanceRange;
+
+	rngState = 0x9E3779B97F4A7C15ull;
+
+	for (i = 1; i < (uint32_t) argc; i += 1)
+	{
+		if (strcmp(argv[i], "--rounds") == 0 && i + 1 < (uint32_t) argc)
+		{
+			rounds = (uint32_t) strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < (uint32_t) argc)
+		{
+			rngState = strtoull(argv[++i], NULL, 10) | 1;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--rounds N] [--seed N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* The multi-page font has its capitals on the second page */
+	pageCodepointCounts[0] = 0;
+	pageCodepointCounts[1] = 0;
+	for (i = ' '; i < 127; i += 1)
+	{
+		codepoints[codepointCount] = i;
+		codepointCount += 1;
+
+		j = (i >= 'A' && i <= 'Z') ? 1 : 0;
+		pageCodepoints[j][pageCodepointCounts[j]] = i;
+		pageCodepointCounts[j] += 1;
+	}
+
+	BenchFixture_Create(codepoints, codepointCount, 0, 0, &fixture);
+
+	for (i = 0; i < 2; i += 1)
+	{
+		BenchFixture_Create(pageCodepoints[i], pageCodepointCounts[i], 0, 0, &pageFixtures[i]);
+		pageJsonBytes[i] = pageFixtures[i].atlasJsonBytes;
+		pageJsonBytesLengths[i] = pageFixtures[i].atlasJsonBytesLength;
+	}
+
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		if (i == MULTI_PAGE_FONT)
+		{
+			fonts[i] = Wellspring_CreateFontFromPages(
+				fixture.fontBytes,
+				fixture.fontBytesLength,
+				pageJsonBytes,
+				pageJsonBytesLengths,
+				2,
+				&pixelsPerEm,
+				&distanceRange
+			);
+			Wellspring_SetFontAtlasID(fonts[i], i + 1);
+			continue;
+		}
+
+		fonts[i] = Wellspring_CreateFont(
+			fixture.fontBytes,
+			fixture.fontBytesLength,
+			fixture.atlasJsonBytes,
+			fixture.atlasJsonBytesLength,
+			&pixelsPerEm,
+			&distanceRange
+		);
+		Wellspring_SetFontAtlasID(fonts[i], i + 1);
+	}
+
+	BenchFixture_Destroy(&fixture);
+	for (i = 0; i < 2; i += 1)
+	{
+		BenchFixture_Destroy(&pageFixtures[i]);
+	}
+
+	referenceBatch = Wellspring_CreateTextBatch();
+	batches[0] = Wellspring_CreateTextBatch();
+	batches[1] = Wellspring_CreateSegmentedTextBatch(SEGMENT_VERTICES);
+
+	for (i = 0; i < 2; i += 1)
+	{
+		if (!RunFixedCases(batches[i], 1, labels[i]) || !RunFixedCases(batches[i], FONT_COUNT, labels[i]) || !RunMultiPageCases(batches[i], labels[i]) || !RunRetainedCase(batches[i], labels[i]))
+		{
+			return 1;
+		}
+
+		for (j = 0; j < rounds; j += 1)
+		{
+			if (!RunRound(batches[i], labels[i]))
+			{
+				fprintf(stderr, "failed in round %u\n", j);
+				return 1;
+			}
+		}
+	}
+
+	printf("%u rounds of chunk edits finalized correctly\n", rounds);
+
+	for (i = 0; i < 2; i += 1)
+	{
+		Wellspring_DestroyTextBatch(batches[i]);
+	}
+	Wellspring_DestroyTextBatch(referenceBatch);
+
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		Wellspring_DestroyFont(fonts[i]);
+	}
+
+	return 0;
+}
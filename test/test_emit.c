@@ -0,0 +1,172 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Differential test of the quad emission kernels.
+ *
+ * Usage: wellspring_test_emit [--iterations N] [--seed N]
+ *
+ * Runs EmitQuad_Scalar and the kernel Wellspring picked for this platform on
+ * the same random glyphs, pages, pen positions and transforms, and fails on
+ * the first quad whose vertices differ in any bit. On platforms without a
+ * SIMD kernel both are the scalar kernel and the test passes trivially.
+ *
+ * The kernels are static, so the test compiles Wellspring.c in directly.
+ */
+
+#include "Wellspring.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_COUNT 4
+
+static uint64_t rngState;
+
+static uint32_t NextRandom(void)
+{
+	/* xorshift64* */
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (uint32_t) ((rngState * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * (float) (NextRandom() >> 8) / (float) (1 << 24);
+}
+
+static const char* KernelName(void)
+{
+#if defined(SDL_SSE2_INTRINSICS)
+	return "SSE2";
+#elif defined(SDL_NEON_INTRINSICS)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	AtlasPage pages[PAGE_COUNT];
+	GlyphMetrics metrics;
+	AtlasRect atlasRect;
+	Wellspring_Transform transform;
+	Affine affine;
+	QuadEmitter emitter;
+	Wellspring_Vertex *expected, *actual;
+	uint32_t iterations = 1000000;
+	uint32_t i, page;
+	float x, y;
+
+	rngState = 0x9E3779B97F4A7C15ull;
+
+	for (i = 1; i < (uint32_t) argc; i += 1)
+	{
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < (uint32_t) argc)
+		{
+			iterations = (uint32_t) strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < (uint32_t) argc)
+		{
+			rngState = strtoull(argv[++i], NULL, 10) | 1;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--iterations N] [--seed N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Quads start on a multiple of four vertices, so the SIMD stores are aligned */
+	expected = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * 4);
+	actual = Wellspring_aligned_alloc(VERTEX_ALIGNMENT, sizeof(Wellspring_Vertex) * 4);
+
+	for (page = 0; page < PAGE_COUNT; page += 1)
+	{
+		Wellspring_INTERNAL_SetPageSize(&pages[page], 1 + NextRandom() % 16384, 1 + NextRandom() % 16384);
+	}
+
+	for (i = 0; i < iterations; i += 1)
+	{
+		metrics.planeLeft = (int16_t) NextRandom();
+		metrics.planeTop = (int16_t) NextRandom();
+		metrics.planeRight = (int16_t) NextRandom();
+		metrics.planeBottom = (int16_t) NextRandom();
+		metrics.xAdvance = RandomFloat(0, 2);
+		metrics.flags = 0;
+		metrics.page = (uint16_t) (NextRandom() % PAGE_COUNT);
+
+		atlasRect.left = (uint16_t) NextRandom();
+		atlasRect.top = (uint16_t) NextRandom();
+		atlasRect.right = (uint16_t) NextRandom();
+		atlasRect.bottom = (uint16_t) NextRandom();
+
+		emitter.scale = RandomFloat(1, 200);
+		emitter.planeScale = emitter.scale / PLANE_UNITS_PER_EM;
+		emitter.pages = pages;
+		emitter.chunkIndex = NextRandom();
+		emitter.affine = NULL;
+
+		/* Half the quads are transformed */
+		if (NextRandom() & 1)
+		{
+			transform.translateX = RandomFloat(-4096, 4096);
+			transform.translateY = RandomFloat(-4096, 4096);
+			transform.scaleX = RandomFloat(-4, 4);
+			transform.scaleY = RandomFloat(-4, 4);
+			transform.rotation = RandomFloat(-7, 7);
+			Wellspring_INTERNAL_GetAffine(&transform, &affine);
+			emitter.affine = &affine;
+		}
+
+		x = RandomFloat(-8192, 8192);
+		y = RandomFloat(-8192, 8192);
+
+		/* Padding bytes would compare as garbage otherwise */
+		memset(expected, 0, sizeof(Wellspring_Vertex) * 4);
+		memset(actual, 0, sizeof(Wellspring_Vertex) * 4);
+
+		EmitQuad_Scalar(&emitter, &metrics, &atlasRect, x, y, expected);
+		EmitQuad(&emitter, &metrics, &atlasRect, x, y, actual);
+
+		if (memcmp(expected, actual, sizeof(Wellspring_Vertex) * 4) != 0)
+		{
+			fprintf(stderr, "%s kernel differs from the scalar kernel at iteration %u\n", KernelName(), i);
+			Wellspring_aligned_free(expected);
+			Wellspring_aligned_free(actual);
+			return 1;
+		}
+	}
+
+	printf("%s kernel matches the scalar kernel on %u quads\n", KernelName(), iterations);
+
+	Wellspring_aligned_free(expected);
+	Wellspring_aligned_free(actual);
+	return 0;
+}
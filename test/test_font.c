@@ -0,0 +1,121 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Font creation checks.
+ *
+ * Usage: wellspring_test_font
+ *
+ * Checks that Wellspring_CreateFont rejects atlases whose pages or glyph
+ * bounds don't fit the 16-bit glyph tables, and accepts them at the limits.
+ */
+
+#include "Wellspring.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ATLAS_LIMIT 32767 /* texels, atlas rects are stored in half texels */
+#define PLANE_LIMIT 7.99 /* ems, plane bounds are stored in 1/4096 ems */
+
+typedef struct FontCase
+{
+	const char *name;
+	uint32_t width;
+	double atlasRight;
+	double planeTop;
+	uint8_t valid;
+} FontCase;
+
+static const FontCase cases[] = {
+	{ "at the limits", ATLAS_LIMIT, ATLAS_LIMIT, -PLANE_LIMIT, 1 },
+	{ "page too wide", ATLAS_LIMIT + 1, 32, -0.75, 0 },
+	{ "atlas bounds too far right", 4096, ATLAS_LIMIT + 1, -0.75, 0 },
+	{ "atlas bounds negative", 4096, -1, -0.75, 0 },
+	{ "plane bounds too tall", 4096, 32, -8.5, 0 },
+	{ "plane bounds too wide", 4096, 32, 8.5, 0 }
+};
+
+static uint8_t RunCase(const FontCase *fontCase)
+{
+	Wellspring_Font *font;
+	char json[1024];
+	float pixelsPerEm, distanceRange;
+	int length;
+
+	length = snprintf(
+		json,
+		sizeof(json),
+		"{\"atlas\":{\"type\":\"msdf\",\"distanceRange\":4,\"size\":32,\"width\":%u,\"height\":32,\"yOrigin\":\"top\"},"
+		"\"metrics\":{\"emSize\":1,\"lineHeight\":1.2,\"ascender\":-0.8,\"descender\":0.2,\"underlineY\":0.1,\"underlineThickness\":0.05},"
+		"\"glyphs\":[{\"unicode\":65,\"advance\":0.6,"
+		"\"planeBounds\":{\"left\":0.05,\"bottom\":0.2,\"right\":0.55,\"top\":%g},"
+		"\"atlasBounds\":{\"left\":0.5,\"bottom\":31.5,\"right\":%g,\"top\":0.5}}]}",
+		fontCase->width,
+		fontCase->planeTop,
+		fontCase->atlasRight
+	);
+
+	font = Wellspring_CreateFont(NULL, 0, (const uint8_t*) json, (uint32_t) length, &pixelsPerEm, &distanceRange);
+
+	if ((font != NULL) != fontCase->valid)
+	{
+		fprintf(stderr, "%s: font was %s\n", fontCase->name, font != NULL ? "accepted" : "rejected");
+		if (font != NULL)
+		{
+			Wellspring_DestroyFont(font);
+		}
+		return 0;
+	}
+
+	if (font != NULL)
+	{
+		Wellspring_DestroyFont(font);
+	}
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t i;
+
+	if (argc > 1)
+	{
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i += 1)
+	{
+		if (!RunCase(&cases[i]))
+		{
+			return 1;
+		}
+	}
+
+	printf("%u font limit cases passed\n", i);
+	return 0;
+}
@@ -0,0 +1,304 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Kerning table test.
+ *
+ * Usage: wellspring_test_kerning [FONT_FILE...]
+ *
+ * Fonts keep no font file around, so kerning is read into a table when they
+ * are created. This checks the table against stbtt_GetCodepointKernAdvance
+ * for every pair of glyphs the atlas has, on the synthetic kern table the
+ * benchmarks use. Font files given on the command line are checked as well,
+ * with an atlas of every codepoint they map, which covers GPOS kerning and
+ * splitting the pairs over several threads on large fonts.
+ * Atlas kerning is checked on an atlas that doesn't list its glyphs in
+ * codepoint order.
+ *
+ * The table is internal, so the test compiles Wellspring.c in directly.
+ */
+
+#include "Wellspring.c"
+#include "bench_fixture.h"
+
+#include <SDL3/SDL_iostream.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIXTURE_GLYPHS 1200
+#define FIXTURE_KERNING_PAIRS 8000
+#define MAX_CODEPOINT 0x2FFFF
+
+typedef struct Buffer
+{
+	char *data;
+	uint32_t length;
+	uint32_t capacity;
+} Buffer;
+
+static void Buffer_Printf(Buffer *buffer, const char *format, ...)
+{
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	while (buffer->length + length + 1 > buffer->capacity)
+	{
+		buffer->capacity = buffer->capacity == 0 ? 4096 : buffer->capacity * 2;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+
+	va_start(args, format);
+	vsnprintf(buffer->data + buffer->length, length + 1, format, args);
+	va_end(args);
+
+	buffer->length += length;
+}
+
+/* Compares every pair of glyphs in the font's table with stb_truetype */
+static uint8_t CheckFont(const char *name, const uint8_t *fontBytes, uint32_t fontBytesLength, const uint8_t *atlasJson, uint32_t atlasJsonLength)
+{
+	Font *font;
+	stbtt_fontinfo fontInfo;
+	const CharRange *firstRange, *secondRange;
+	const GlyphMetrics *first, *second;
+	uint32_t r, s, i, j, mismatches = 0;
+	uint64_t pairs = 0;
+	float pixelsPerEm, distanceRange, expected, actual;
+
+	font = (Font*) Wellspring_CreateFont(fontBytes, fontBytesLength, atlasJson, atlasJsonLength, &pixelsPerEm, &distanceRange);
+	if (font == NULL || !stbtt_InitFont(&fontInfo, fontBytes, 0))
+	{
+		fprintf(stderr, "%s: couldn't load the font\n", name);
+		return 0;
+	}
+
+	for (r = 0; r < font->packer.rangeCount; r += 1)
+	{
+		firstRange = &font->packer.ranges[r];
+
+		for (i = 0; i < firstRange->charCount; i += 1)
+		{
+			first = &firstRange->data[i];
+
+			for (s = 0; s < font->packer.rangeCount; s += 1)
+			{
+				secondRange = &font->packer.ranges[s];
+
+				for (j = 0; j < secondRange->charCount; j += 1)
+				{
+					second = &secondRange->data[j];
+					expected = (float) stbtt_GetCodepointKernAdvance(&fontInfo, firstRange->firstCodepoint + i, secondRange->firstCodepoint + j);
+					/* Layout only looks pairs up after glyphs flagged as kerned */
+					actual = (first->flags & GLYPH_FLAG_KERNING) ? Wellspring_INTERNAL_GetKerning(font, first, second) : 0;
+
+					if (actual != expected)
+					{
+						if (mismatches < 8)
+						{
+							fprintf(
+								stderr,
+								"%s: U+%04X U+%04X kerns by %g, stb_truetype says %g\n",
+								name,
+								firstRange->firstCodepoint + i,
+								secondRange->firstCodepoint + j,
+								actual,
+								expected
+							);
+						}
+						mismatches += 1;
+					}
+
+					pairs += expected != 0;
+				}
+			}
+		}
+	}
+
+	Wellspring_DestroyFont((Wellspring_Font*) font);
+
+	if (mismatches > 0)
+	{
+		fprintf(stderr, "%s: %u pairs differ\n", name, mismatches);
+		return 0;
+	}
+
+	printf("%s: %llu kerning pairs match stb_truetype\n", name, (unsigned long long) pairs);
+	return 1;
+}
+
+static uint8_t CheckFixture(void)
+{
+	uint32_t codepoints[FIXTURE_GLYPHS];
+	BenchFixture fixture;
+	uint32_t i;
+	uint8_t result;
+
+	/* ASCII, then a run past it so the glyph table has several ranges */
+	for (i = 0; i < FIXTURE_GLYPHS; i += 1)
+	{
+		codepoints[i] = i < 95 ? ' ' + i : 0x100 + i;
+	}
+
+	BenchFixture_Create(codepoints, FIXTURE_GLYPHS, FIXTURE_KERNING_PAIRS, 0, &fixture);
+	result = CheckFont("fixture", fixture.fontBytes, fixture.fontBytesLength, fixture.atlasJsonBytes, fixture.atlasJsonBytesLength);
+	BenchFixture_Destroy(&fixture);
+
+	return result;
+}
+
+/* Pairs are looked up by codepoint, so the glyph order in the JSON must not matter */
+static uint8_t CheckUnsortedAtlas(void)
+{
+	static const char *glyphOrders[] = {
+		"{\"unicode\":65,\"advance\":0.5},{\"unicode\":66,\"advance\":0.75}",
+		"{\"unicode\":66,\"advance\":0.75},{\"unicode\":65,\"advance\":0.5}"
+	};
+	Font *font;
+	const GlyphMetrics *a, *b;
+	char json[1024];
+	float pixelsPerEm, distanceRange;
+	uint32_t i;
+	int length;
+
+	for (i = 0; i < 2; i += 1)
+	{
+		length = snprintf(
+			json,
+			sizeof(json),
+			"{\"atlas\":{\"type\":\"msdf\",\"distanceRange\":4,\"size\":32,\"width\":64,\"height\":64,\"yOrigin\":\"top\"},"
+			"\"metrics\":{\"emSize\":1,\"lineHeight\":1.2,\"ascender\":-0.8,\"descender\":0.2,\"underlineY\":0.1,\"underlineThickness\":0.05},"
+			"\"glyphs\":[%s],"
+			"\"kerning\":[{\"unicode1\":65,\"unicode2\":66,\"advance\":-0.25}]}",
+			glyphOrders[i]
+		);
+
+		font = (Font*) Wellspring_CreateFont(NULL, 0, (const uint8_t*) json, (uint32_t) length, &pixelsPerEm, &distanceRange);
+		if (font == NULL)
+		{
+			fprintf(stderr, "unsorted atlas %u: couldn't load the font\n", i);
+			return 0;
+		}
+
+		a = Wellspring_INTERNAL_FindGlyph(&font->packer, 'A');
+		b = Wellspring_INTERNAL_FindGlyph(&font->packer, 'B');
+
+		if (
+			a == NULL || b == NULL ||
+			a->xAdvance != 0.5f || b->xAdvance != 0.75f ||
+			!(a->flags & GLYPH_FLAG_KERNING) || (b->flags & GLYPH_FLAG_KERNING) ||
+			Wellspring_INTERNAL_GetKerning(font, a, b) != -0.25f
+		) {
+			fprintf(stderr, "unsorted atlas %u: the A B pair is lost\n", i);
+			Wellspring_DestroyFont((Wellspring_Font*) font);
+			return 0;
+		}
+
+		Wellspring_DestroyFont((Wellspring_Font*) font);
+	}
+
+	printf("atlas kerning doesn't depend on the glyph order\n");
+	return 1;
+}
+
+/* An atlas of every codepoint the font maps. Kerning doesn't look at the atlas bounds, so there are none. */
+static uint8_t CheckFontFile(const char *path)
+{
+	stbtt_fontinfo fontInfo;
+	Buffer json = { 0 };
+	uint8_t *fontBytes;
+	size_t fontBytesLength;
+	uint32_t codepoint, glyphCount = 0;
+	int advanceWidth, bearing, ascent, descent, lineGap;
+	float emScale;
+	uint8_t result;
+
+	fontBytes = SDL_LoadFile(path, &fontBytesLength);
+	if (fontBytes == NULL || !stbtt_InitFont(&fontInfo, fontBytes, 0))
+	{
+		fprintf(stderr, "%s: couldn't read the font file\n", path);
+		SDL_free(fontBytes);
+		return 0;
+	}
+
+	emScale = stbtt_ScaleForMappingEmToPixels(&fontInfo, 1);
+	stbtt_GetFontVMetrics(&fontInfo, &ascent, &descent, &lineGap);
+
+	Buffer_Printf(
+		&json,
+		"{\"atlas\":{\"type\":\"msdf\",\"distanceRange\":4,\"size\":32,\"width\":4096,\"height\":4096,\"yOrigin\":\"top\"},"
+		"\"metrics\":{\"emSize\":1,\"lineHeight\":%g,\"ascender\":%g,\"descender\":%g,\"underlineY\":0.1,\"underlineThickness\":0.05},"
+		"\"glyphs\":[",
+		(ascent - descent + lineGap) * emScale,
+		-ascent * emScale,
+		-descent * emScale
+	);
+
+	for (codepoint = 0; codepoint <= MAX_CODEPOINT; codepoint += 1)
+	{
+		if (stbtt_FindGlyphIndex(&fontInfo, codepoint) == 0)
+		{
+			continue;
+		}
+
+		stbtt_GetCodepointHMetrics(&fontInfo, codepoint, &advanceWidth, &bearing);
+		Buffer_Printf(&json, "%s{\"unicode\":%u,\"advance\":%g}", glyphCount == 0 ? "" : ",", codepoint, advanceWidth * emScale);
+		glyphCount += 1;
+	}
+
+	Buffer_Printf(&json, "]}");
+
+	result = CheckFont(path, fontBytes, (uint32_t) fontBytesLength, (const uint8_t*) json.data, json.length);
+
+	free(json.data);
+	SDL_free(fontBytes);
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	if (!CheckFixture() || !CheckUnsortedAtlas())
+	{
+		return 1;
+	}
+
+	for (i = 1; i < argc; i += 1)
+	{
+		if (!CheckFontFile(argv[i]))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Prepared text checks.
+ *
+ * Usage: wellspring_test_prepared
+ *
+ * Lays out the same strings through the UTF-8 functions and through prepared
+ * text, for every alignment, with and without a transform, and checks that
+ * the vertices and bounds are byte-identical. The strings cover kerning from
+ * the font file and from the atlas, newlines, codepoints missing from the
+ * atlas and the empty string.
+ */
+
+#include "Wellspring.h"
+#include "bench_fixture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FONT_COUNT 2
+#define KERNING_PAIRS 10000
+
+static const char *strings[] = {
+	"",
+	"Hello, World!",
+	"AVAWAY To. Ty, LT",
+	"first line\nsecond line\n\nfourth",
+	"\n",
+	"missing \xC3\xA9 and \xE2\x82\xAC glyphs",
+	"\xE6\x97\xA5\xE6\x9C\xAC",
+	" leading and trailing "
+};
+
+static const int pixelSizes[] = { 16, 37 };
+
+static uint8_t CheckString(
+	Wellspring_Font *font,
+	Wellspring_TextBatch *directBatch,
+	Wellspring_TextBatch *preparedBatch,
+	const char *str
+) {
+	Wellspring_Transform transform = { 12.5f, -3.25f, 0.6f, 1.5f, 0.75f };
+	Wellspring_PreparedText *prepared;
+	Wellspring_Rectangle directBounds, preparedBounds;
+	Wellspring_Vertex *directVertices, *preparedVertices;
+	uint32_t directCount, preparedCount, size, horizontal, vertical, transformed;
+	uint8_t directResult, preparedResult;
+	uint32_t length = (uint32_t) strlen(str);
+
+	prepared = Wellspring_PrepareText(font, (const uint8_t*) str, length);
+	if (prepared == NULL)
+	{
+		fprintf(stderr, "PrepareText failed on \"%s\"\n", str);
+		return 0;
+	}
+
+	for (size = 0; size < sizeof(pixelSizes) / sizeof(pixelSizes[0]); size += 1)
+	for (horizontal = WELLSPRING_HORIZONTALALIGNMENT_LEFT; horizontal <= WELLSPRING_HORIZONTALALIGNMENT_RIGHT; horizontal += 1)
+	for (vertical = WELLSPRING_VERTICALALIGNMENT_BASELINE; vertical <= WELLSPRING_VERTICALALIGNMENT_BOTTOM; vertical += 1)
+	{
+		memset(&directBounds, 0, sizeof(directBounds));
+		memset(&preparedBounds, 0, sizeof(preparedBounds));
+
+		directResult = Wellspring_TextBounds(
+			font,
+			pixelSizes[size],
+			(Wellspring_HorizontalAlignment) horizontal,
+			(Wellspring_VerticalAlignment) vertical,
+			(const uint8_t*) str,
+			length,
+			&directBounds
+		);
+		preparedResult = Wellspring_TextBoundsPrepared(
+			prepared,
+			pixelSizes[size],
+			(Wellspring_HorizontalAlignment) horizontal,
+			(Wellspring_VerticalAlignment) vertical,
+			&preparedBounds
+		);
+
+		if (directResult != preparedResult || memcmp(&directBounds, &preparedBounds, sizeof(Wellspring_Rectangle)) != 0)
+		{
+			fprintf(stderr, "\"%s\" at %d px, alignment %u/%u: prepared bounds differ\n", str, pixelSizes[size], horizontal, vertical);
+			Wellspring_DestroyPreparedText(prepared);
+			return 0;
+		}
+
+		for (transformed = 0; transformed < 2; transformed += 1)
+		{
+			Wellspring_StartTextBatch(directBatch);
+			Wellspring_StartTextBatch(preparedBatch);
+
+			directResult = Wellspring_AddChunkToTextBatchWithTransform(
+				directBatch,
+				font,
+				pixelSizes[size],
+				(Wellspring_HorizontalAlignment) horizontal,
+				(Wellspring_VerticalAlignment) vertical,
+				(const uint8_t*) str,
+				length,
+				transformed ? &transform : NULL
+			);
+			preparedResult = Wellspring_AddChunkToTextBatchPrepared(
+				preparedBatch,
+				prepared,
+				pixelSizes[size],
+				(Wellspring_HorizontalAlignment) horizontal,
+				(Wellspring_VerticalAlignment) vertical,
+				transformed ? &transform : NULL
+			);
+
+			Wellspring_GetBufferData(directBatch, &directCount, &directVertices);
+			Wellspring_GetBufferData(preparedBatch, &preparedCount, &preparedVertices);
+
+			if (
+				directResult != preparedResult ||
+				directCount != preparedCount ||
+				(directCount > 0 && memcmp(directVertices, preparedVertices, sizeof(Wellspring_Vertex) * directCount) != 0)
+			) {
+				fprintf(stderr, "\"%s\" at %d px, alignment %u/%u, transform %u: prepared vertices differ\n", str, pixelSizes[size], horizontal, vertical, transformed);
+				Wellspring_DestroyPreparedText(prepared);
+				return 0;
+			}
+		}
+	}
+
+	Wellspring_DestroyPreparedText(prepared);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t codepoints[128];
+	BenchFixture fixture;
+	Wellspring_Font *fonts[FONT_COUNT];
+	Wellspring_TextBatch *directBatch, *preparedBatch;
+	uint32_t codepointCount = 0, i, j;
+	float pixelsPerEm, distanceRange;
+	uint8_t result = 1;
+
+	if (argc > 1)
+	{
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 1;
+	}
+
+	for (i = ' '; i < 127; i += 1)
+	{
+		codepoints[codepointCount] = i;
+		codepointCount += 1;
+	}
+
+	/* Kerning read from the font file, then from the atlas */
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		BenchFixture_Create(codepoints, codepointCount, KERNING_PAIRS, (uint8_t) i, &fixture);
+		fonts[i] = Wellspring_CreateFont(
+			fixture.fontBytes,
+			fixture.fontBytesLength,
+			fixture.atlasJsonBytes,
+			fixture.atlasJsonBytesLength,
+			&pixelsPerEm,
+			&distanceRange
+		);
+		BenchFixture_Destroy(&fixture);
+
+		if (fonts[i] == NULL)
+		{
+			fprintf(stderr, "CreateFont failed\n");
+			return 1;
+		}
+	}
+
+	directBatch = Wellspring_CreateTextBatch();
+	preparedBatch = Wellspring_CreateTextBatch();
+
+	for (i = 0; i < FONT_COUNT && result; i += 1)
+	{
+		for (j = 0; j < sizeof(strings) / sizeof(strings[0]) && result; j += 1)
+		{
+			result = CheckString(fonts[i], directBatch, preparedBatch, strings[j]);
+		}
+
+		if (result && Wellspring_PrepareText(fonts[i], (const uint8_t*) "bad \xFF", 5) != NULL)
+		{
+			fprintf(stderr, "PrepareText accepted invalid UTF-8\n");
+			result = 0;
+		}
+	}
+
+	if (result)
+	{
+		printf("prepared text matches direct layout for %u strings\n", (uint32_t) (sizeof(strings) / sizeof(strings[0])));
+	}
+
+	Wellspring_DestroyTextBatch(directBatch);
+	Wellspring_DestroyTextBatch(preparedBatch);
+
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		Wellspring_DestroyFont(fonts[i]);
+	}
+
+	return result ? 0 : 1;
+}
@@ -0,0 +1,482 @@
+/* Wellspring - An immediate mode font rendering system in C
+ *
+ * Copyright (c) 2022-2024 Evan Hemsley
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Evan "cosmonaut" Hemsley <evan@moonside.games>
+ *
+ */
+
+/* Threaded layout test.
+ *
+ * Usage: wellspring_test_threads [--iterations N] [--threads N] [--seed N]
+ *
+ * Lays out the same chunks from several threads and checks that the
+ * finalized vertices and draw ranges are byte-identical to adding the chunks
+ * serially on one batch:
+ * - every thread lays out a slice of the chunks into its own batch, and the
+ *   batches are merged in order
+ * - Wellspring_AddChunksParallel, with the default parallel-for and with one
+ *   that hands out small interleaved blocks to the threads
+ * - every thread appends interleaved chunks to one batch with
+ *   Wellspring_AddChunkToTextBatchConcurrent, after some serial chunks, with
+ *   and without reserving the batch up front
+ *
+ * Configure with -DWELLSPRING_SANITIZE_THREADS=ON to run it under
+ * ThreadSanitizer.
+ */
+
+#include "Wellspring.h"
+#include "bench_fixture.h"
+
+#include <SDL3/SDL_thread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FONT_COUNT 2
+#define MAX_THREADS 64
+#define CHUNK_COUNT 4096
+#define MAX_TEXT_LENGTH 48
+#define TRANSFORM_COUNT 4
+#define PARALLEL_BLOCK 7
+#define SERIAL_CHUNKS 64 /* added before the concurrent ones */
+
+typedef struct Expected
+{
+	Wellspring_Vertex *vertices;
+	uint32_t vertexCount;
+	Wellspring_DrawRange *drawRanges;
+	uint32_t drawRangeCount;
+} Expected;
+
+typedef struct SliceThread
+{
+	Wellspring_TextBatch *batch;
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+	uint8_t result;
+} SliceThread;
+
+typedef struct ConcurrentThread
+{
+	Wellspring_TextBatch *batch;
+	uint32_t thread;
+	uint32_t threadCount;
+	uint8_t result;
+} ConcurrentThread;
+
+typedef struct BlockThread
+{
+	uint32_t thread;
+	uint32_t threadCount;
+	uint32_t count;
+	Wellspring_ParallelTask task;
+	void *taskData;
+} BlockThread;
+
+static Wellspring_Font *fonts[FONT_COUNT];
+static Wellspring_Transform transforms[TRANSFORM_COUNT];
+static Wellspring_ChunkDescriptor chunks[CHUNK_COUNT];
+static uint8_t texts[CHUNK_COUNT][MAX_TEXT_LENGTH];
+static uint64_t rngState;
+
+static uint32_t NextRandom(void)
+{
+	/* xorshift64* */
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (uint32_t) ((rngState * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static void MakeChunks(void)
+{
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789.,!?\n";
+	Wellspring_ChunkDescriptor *chunk;
+	uint32_t i, j;
+
+	for (i = 0; i < TRANSFORM_COUNT; i += 1)
+	{
+		transforms[i].translateX = (float) (NextRandom() % 1024);
+		transforms[i].translateY = (float) (NextRandom() % 1024);
+		transforms[i].scaleX = 1.0f + i * 0.25f;
+		transforms[i].scaleY = 1.0f + i * 0.25f;
+		transforms[i].rotation = i * 0.3f;
+	}
+
+	for (i = 0; i < CHUNK_COUNT; i += 1)
+	{
+		chunk = &chunks[i];
+		chunk->font = fonts[NextRandom() % FONT_COUNT];
+		chunk->pixelSize = 8 + NextRandom() % 24;
+		chunk->horizontalAlignment = (Wellspring_HorizontalAlignment) (NextRandom() % 3);
+		chunk->verticalAlignment = (Wellspring_VerticalAlignment) (NextRandom() % 4);
+		chunk->strLengthInBytes = NextRandom() % MAX_TEXT_LENGTH;
+		chunk->strBytes = texts[i];
+		chunk->transform = NextRandom() % 2 ? &transforms[NextRandom() % TRANSFORM_COUNT] : NULL;
+
+		for (j = 0; j < chunk->strLengthInBytes; j += 1)
+		{
+			texts[i][j] = (uint8_t) alphabet[NextRandom() % (sizeof(alphabet) - 1)];
+		}
+	}
+}
+
+static uint8_t AddChunks(Wellspring_TextBatch *batch, uint32_t firstChunk, uint32_t chunkCount)
+{
+	Wellspring_ChunkDescriptor *chunk;
+	uint32_t i;
+
+	for (i = firstChunk; i < firstChunk + chunkCount; i += 1)
+	{
+		chunk = &chunks[i];
+		if (!Wellspring_AddChunkToTextBatchWithTransform(
+			batch,
+			chunk->font,
+			chunk->pixelSize,
+			chunk->horizontalAlignment,
+			chunk->verticalAlignment,
+			chunk->strBytes,
+			chunk->strLengthInBytes,
+			chunk->transform
+		)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static uint8_t Compare(Wellspring_TextBatch *batch, const Expected *expected, const char *label, uint32_t iteration)
+{
+	Wellspring_Vertex *vertices;
+	Wellspring_DrawRange *drawRanges;
+	uint32_t vertexCount, drawRangeCount;
+
+	Wellspring_FinalizeTextBatch(batch);
+	Wellspring_GetBufferData(batch, &vertexCount, &vertices);
+	Wellspring_GetDrawRanges(batch, &drawRangeCount, &drawRanges);
+
+	if (
+		Wellspring_GetTextBatchChunkCount(batch) != CHUNK_COUNT ||
+		vertexCount != expected->vertexCount ||
+		memcmp(vertices, expected->vertices, sizeof(Wellspring_Vertex) * vertexCount) != 0
+	) {
+		fprintf(stderr, "%s: vertices differ from serial layout in iteration %u\n", label, iteration);
+		return 0;
+	}
+
+	if (
+		drawRangeCount != expected->drawRangeCount ||
+		memcmp(drawRanges, expected->drawRanges, sizeof(Wellspring_DrawRange) * drawRangeCount) != 0
+	) {
+		fprintf(stderr, "%s: draw ranges differ from serial layout in iteration %u\n", label, iteration);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int SDLCALL SliceThreadMain(void *data)
+{
+	SliceThread *thread = (SliceThread*) data;
+
+	Wellspring_StartTextBatch(thread->batch);
+	thread->result = AddChunks(thread->batch, thread->firstChunk, thread->chunkCount);
+	return 0;
+}
+
+/* One batch per thread, merged in order */
+static uint8_t RunSeparateBatches(Wellspring_TextBatch *batch, Wellspring_TextBatch **threadBatches, uint32_t threadCount, const Expected *expected, uint32_t iteration)
+{
+	SliceThread slices[MAX_THREADS];
+	SDL_Thread *threads[MAX_THREADS];
+	uint32_t i;
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		slices[i].batch = threadBatches[i];
+		slices[i].firstChunk = CHUNK_COUNT * i / threadCount;
+		slices[i].chunkCount = CHUNK_COUNT * (i + 1) / threadCount - slices[i].firstChunk;
+		threads[i] = SDL_CreateThread(SliceThreadMain, "Layout", &slices[i]);
+	}
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		SDL_WaitThread(threads[i], NULL);
+		if (!slices[i].result)
+		{
+			fprintf(stderr, "separate batches: thread %u failed to add its chunks\n", i);
+			return 0;
+		}
+	}
+
+	Wellspring_StartTextBatch(batch);
+	Wellspring_MergeTextBatches(batch, threadBatches, threadCount);
+
+	return Compare(batch, expected, "separate batches", iteration);
+}
+
+static int SDLCALL BlockThreadMain(void *data)
+{
+	BlockThread *thread = (BlockThread*) data;
+	uint32_t begin;
+
+	for (begin = thread->thread * PARALLEL_BLOCK; begin < thread->count; begin += thread->threadCount * PARALLEL_BLOCK)
+	{
+		thread->task(thread->taskData, begin, SDL_min(begin + PARALLEL_BLOCK, thread->count));
+	}
+
+	return 0;
+}
+
+/* Thread i takes blocks i, i + threadCount, ..., so neighbouring chunks are laid out on different threads */
+static void WELLSPRINGCALL BlockParallelFor(void *userdata, uint32_t count, Wellspring_ParallelTask task, void *taskData)
+{
+	BlockThread blocks[MAX_THREADS];
+	SDL_Thread *threads[MAX_THREADS];
+	uint32_t threadCount = *(uint32_t*) userdata;
+	uint32_t i;
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		blocks[i].thread = i;
+		blocks[i].threadCount = threadCount;
+		blocks[i].count = count;
+		blocks[i].task = task;
+		blocks[i].taskData = taskData;
+		threads[i] = SDL_CreateThread(BlockThreadMain, "Layout", &blocks[i]);
+	}
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		SDL_WaitThread(threads[i], NULL);
+	}
+}
+
+static uint8_t RunParallel(Wellspring_TextBatch *batch, Wellspring_ParallelFor parallelFor, uint32_t threadCount, const Expected *expected, uint32_t iteration)
+{
+	Wellspring_StartTextBatch(batch);
+
+	if (!Wellspring_AddChunksParallel(batch, chunks, CHUNK_COUNT, parallelFor, &threadCount))
+	{
+		fprintf(stderr, "parallel: Wellspring_AddChunksParallel failed in iteration %u\n", iteration);
+		return 0;
+	}
+
+	return Compare(batch, expected, parallelFor == NULL ? "parallel, default" : "parallel, blocks", iteration);
+}
+
+static int SDLCALL ConcurrentThreadMain(void *data)
+{
+	ConcurrentThread *thread = (ConcurrentThread*) data;
+	Wellspring_ChunkDescriptor *chunk;
+	uint32_t i;
+
+	thread->result = 1;
+
+	/* Interleaved, so every thread's keys land between the others' */
+	for (i = SERIAL_CHUNKS + thread->thread; i < CHUNK_COUNT; i += thread->threadCount)
+	{
+		chunk = &chunks[i];
+		if (!Wellspring_AddChunkToTextBatchConcurrent(
+			thread->batch,
+			i,
+			chunk->font,
+			chunk->pixelSize,
+			chunk->horizontalAlignment,
+			chunk->verticalAlignment,
+			chunk->strBytes,
+			chunk->strLengthInBytes,
+			chunk->transform
+		)) {
+			thread->result = 0;
+		}
+	}
+
+	return 0;
+}
+
+static uint8_t RunConcurrent(Wellspring_TextBatch *batch, uint32_t threadCount, uint8_t reserve, const Expected *expected, uint32_t iteration)
+{
+	ConcurrentThread appenders[MAX_THREADS];
+	SDL_Thread *threads[MAX_THREADS];
+	uint32_t i;
+
+	Wellspring_StartTextBatch(batch);
+
+	/* Without a reservation the batch grows while the threads append */
+	if (reserve)
+	{
+		Wellspring_ReserveTextBatch(batch, expected->vertexCount);
+	}
+
+	if (!AddChunks(batch, 0, SERIAL_CHUNKS))
+	{
+		fprintf(stderr, "concurrent: serial layout failed in iteration %u\n", iteration);
+		return 0;
+	}
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		appenders[i].batch = batch;
+		appenders[i].thread = i;
+		appenders[i].threadCount = threadCount;
+		threads[i] = SDL_CreateThread(ConcurrentThreadMain, "Append", &appenders[i]);
+	}
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		SDL_WaitThread(threads[i], NULL);
+		if (!appenders[i].result)
+		{
+			fprintf(stderr, "concurrent: thread %u failed to append in iteration %u\n", i, iteration);
+			return 0;
+		}
+	}
+
+	return Compare(batch, expected, reserve ? "concurrent, reserved" : "concurrent, growing", iteration);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t codepoints[128];
+	BenchFixture fixture;
+	Expected expected;
+	Wellspring_TextBatch *batch, *threadBatches[MAX_THREADS];
+	Wellspring_Vertex *vertices;
+	Wellspring_DrawRange *drawRanges;
+	uint32_t iterations = 20;
+	uint32_t threadCount = 8;
+	uint32_t codepointCount = 0, i;
+	float pixelsPerEm, distanceRange;
+	uint8_t result = 1;
+
+	rngState = 0x9E3779B97F4A7C15ull;
+
+	for (i = 1; i < (uint32_t) argc; i += 1)
+	{
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < (uint32_t) argc)
+		{
+			iterations = (uint32_t) strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < (uint32_t) argc)
+		{
+			threadCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < (uint32_t) argc)
+		{
+			rngState = strtoull(argv[++i], NULL, 10) | 1;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--iterations N] [--threads N] [--seed N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	threadCount = SDL_clamp(threadCount, 1, MAX_THREADS);
+
+	for (i = ' '; i < 127; i += 1)
+	{
+		codepoints[codepointCount] = i;
+		codepointCount += 1;
+	}
+
+	BenchFixture_Create(codepoints, codepointCount, 500, 0, &fixture);
+
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		fonts[i] = Wellspring_CreateFont(
+			fixture.fontBytes,
+			fixture.fontBytesLength,
+			fixture.atlasJsonBytes,
+			fixture.atlasJsonBytesLength,
+			&pixelsPerEm,
+			&distanceRange
+		);
+		Wellspring_SetFontAtlasID(fonts[i], i + 1);
+	}
+
+	BenchFixture_Destroy(&fixture);
+
+	MakeChunks();
+
+	/* Serial layout on one batch is the reference */
+	batch = Wellspring_CreateTextBatch();
+	Wellspring_StartTextBatch(batch);
+	if (!AddChunks(batch, 0, CHUNK_COUNT))
+	{
+		fprintf(stderr, "serial layout failed\n");
+		return 1;
+	}
+	Wellspring_FinalizeTextBatch(batch);
+	Wellspring_GetBufferData(batch, &expected.vertexCount, &vertices);
+	Wellspring_GetDrawRanges(batch, &expected.drawRangeCount, &drawRanges);
+
+	expected.vertices = malloc(sizeof(Wellspring_Vertex) * expected.vertexCount);
+	memcpy(expected.vertices, vertices, sizeof(Wellspring_Vertex) * expected.vertexCount);
+	expected.drawRanges = malloc(sizeof(Wellspring_DrawRange) * expected.drawRangeCount);
+	memcpy(expected.drawRanges, drawRanges, sizeof(Wellspring_DrawRange) * expected.drawRangeCount);
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		threadBatches[i] = Wellspring_CreateTextBatch();
+	}
+
+	for (i = 0; i < iterations && result; i += 1)
+	{
+		result =
+			RunSeparateBatches(batch, threadBatches, threadCount, &expected, i) &&
+			RunParallel(batch, NULL, threadCount, &expected, i) &&
+			RunParallel(batch, BlockParallelFor, threadCount, &expected, i) &&
+			RunConcurrent(batch, threadCount, 1, &expected, i) &&
+			RunConcurrent(batch, threadCount, 0, &expected, i);
+	}
+
+	/* Merging a batch into itself is rejected and leaves it as it was */
+	if (result)
+	{
+		Wellspring_MergeTextBatches(batch, &batch, 1);
+		result = Compare(batch, &expected, "self merge", 0);
+	}
+
+	if (result)
+	{
+		printf("%u threads matched serial layout of %u chunks over %u iterations\n", threadCount, CHUNK_COUNT, iterations);
+	}
+
+	for (i = 0; i < threadCount; i += 1)
+	{
+		Wellspring_DestroyTextBatch(threadBatches[i]);
+	}
+	Wellspring_DestroyTextBatch(batch);
+	free(expected.vertices);
+	free(expected.drawRanges);
+
+	for (i = 0; i < FONT_COUNT; i += 1)
+	{
+		Wellspring_DestroyFont(fonts[i]);
+	}
+
+	return result ? 0 : 1;
+}